@@ -7,6 +7,12 @@
 #ifndef action_h
 #define action_h
 
+#include <cstdio>
+#include "defines.h"
+#include "pos.h"
+
+const unsigned short kNullPackedAction = 0xFFFF;
+
 class Action{
 public:
     Pos prev;
@@ -24,6 +30,39 @@ public:
     bool operator== (Action a) {
         return prev == a.prev && next == a.next;
     }
+    bool IsNull() const { return prev.x < 0; };
+    bool IsOnStage() const { // both squares, as read from a file or a text
+        return prev.x >= 0 && prev.x < kStageWidth && prev.y >= 0 && prev.y < kStageHeight &&
+            next.x >= 0 && next.x < kStageWidth && next.y >= 0 && next.y < kStageHeight;
+    };
+    // 7 bits per square index (y * kStageWidth + x)
+    unsigned short Pack() const {
+        if (IsNull())
+            return kNullPackedAction;
+        return (unsigned short)(((prev.y * kStageWidth + prev.x) << 7) | (next.y * kStageWidth + next.x));
+    };
+    static Action Unpack(unsigned short p) {
+        if (p == kNullPackedAction)
+            return Action();
+        int from = p >> 7, to = p & 0x7F;
+        return Action(from % kStageWidth, from / kStageWidth, to % kStageWidth, to / kStageWidth);
+    };
+};
+
+// Fixed capacity list of actions with an ordering score each, so that move
+// generation needs no heap allocation.
+class ActionList {
+public:
+    static const int kCapacity = 256;
+    Action actions[kCapacity];
+    int scores[kCapacity];
+    int size;
+
+    ActionList() : size(0) {};
+    void push_back(Action a) { actions[size++] = a; };
+    void clear() { size = 0; };
+    bool empty() { return size == 0; };
+    Action& operator[] (int i) { return actions[i]; };
 };
 
 #endif /* action_h */
@@ -0,0 +1,133 @@
+//
+//  analysis.cpp
+//
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <sstream>
+#include "analysis.h"
+#include "janggi.h"
+
+// a line of the input, and its result once analyzed.
+struct AnalysisJob {
+    string line;
+    bool done;
+    vector<string> output;
+};
+
+Analyzer::Analyzer(int threads, int depth, double seconds) :
+    threads(threads > 0 ? threads : 1), depth(depth), seconds(seconds), hashSize(TT_SIZE_MB), multiPV(1)
+{
+}
+
+static void WriteResult(ostream& out, const SearchResult& r)
+{
+    out << "bm ";
+    if (r.action.IsNull())
+        out << "none";
+    else
+        out << r.action.prev.x << r.action.prev.y << r.action.next.x << r.action.next.y;
+    out << " score " << r.score << " depth " << r.depth << " nodes " << r.nodes << " time " << r.seconds << " pv";
+    for (Action a : r.pv)
+        out << " " << a.prev.x << a.prev.y << a.next.x << a.next.y;
+}
+
+// the result of line, a line for each rank when multi-PV.
+static vector<string> Analyze(Janggi& engine, const string& line, int depth, double seconds, int multiPV)
+{
+    Board board;
+    Turn turn;
+    if (!board.SetFromFEN(line, turn))
+        return vector<string>(1, "error not a position");
+    SearchResult r = engine.IterativeDeepening(board, turn, depth, seconds);
+    vector<string> output;
+    if (multiPV <= 1) {
+        ostringstream out;
+        WriteResult(out, r);
+        output.push_back(out.str());
+        return output;
+    }
+    for (const SearchResult& l : engine.GetLines()) {
+        ostringstream out;
+        out << "multipv " << l.rank << " ";
+        WriteResult(out, l);
+        output.push_back(out.str());
+    }
+    return output;
+}
+
+// The reading thread hands lines to the workers and writes the results
+// which are ready in order. At most window lines are between the last
+// written and the last read, which bounds the results held back.
+long long Analyzer::Run(istream& in, ostream& out)
+{
+    const long long window = threads * 4;
+    vector<AnalysisJob> jobs(window);
+    deque<long long> queue; // indexes waiting for a worker
+    mutex lock;
+    condition_variable queued, finished;
+    bool closed = false;
+    long long read = 0, written = 0;
+
+    auto worker = [&]() {
+        Janggi engine;
+        engine.SetTablebasePath(tablebasePath);
+        engine.SetHashSize(hashSize);
+        if (!sharedHash.empty())
+            engine.SetSharedHash(sharedHash, hashSize);
+        engine.SetMultiPV(multiPV);
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            queued.wait(guard, [&]() { return closed || !queue.empty(); });
+            if (queue.empty())
+                return;
+            AnalysisJob& job = jobs[queue.front() % window];
+            queue.pop_front();
+            string line = job.line;
+            guard.unlock();
+            vector<string> output = Analyze(engine, line, depth, seconds, multiPV);
+            guard.lock();
+            job.output = output;
+            job.done = true;
+            finished.notify_one();
+        }
+    };
+    vector<thread> pool;
+    for (int i = 0; i < threads; i++)
+        pool.push_back(thread(worker));
+
+    // writes the results ready, in order. called with the lock held.
+    auto flush = [&]() {
+        while (written < read && jobs[written % window].done) {
+            for (const string& result : jobs[written % window].output)
+                out << written + 1 << " " << result << "\n";
+            written++;
+        }
+        out.flush();
+    };
+
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        unique_lock<mutex> guard(lock);
+        finished.wait(guard, [&]() { flush(); return read - written < window; });
+        AnalysisJob& job = jobs[read % window];
+        job.line = line;
+        job.done = false;
+        queue.push_back(read++);
+        queued.notify_one();
+    }
+    {
+        unique_lock<mutex> guard(lock);
+        closed = true;
+        queued.notify_all();
+        finished.wait(guard, [&]() { flush(); return written == read; });
+    }
+    for (thread& t : pool)
+        t.join();
+    return read;
+}
@@ -0,0 +1,35 @@
+//
+//  analysis.h
+//
+
+#ifndef analysis_h
+#define analysis_h
+
+#include <iostream>
+#include <string>
+#include "defines.h"
+
+// Analyzes positions, one FEN a line, on a pool of threads, each with its
+// own engine. Results are written in the order of the input, and reading
+// waits while too many results are held back by a slow position. With
+// multi-PV, a position gives a line for each rank, best first.
+class Analyzer {
+public:
+    Analyzer(int threads, int depth, double seconds); // seconds <= 0 : no time limit
+    void SetHashSize(size_t mb) { hashSize = mb; };
+    void SetMultiPV(int lines) { multiPV = lines; }; // > 1 : a result line for each of the best lines
+    void SetSharedHash(const string& name) { sharedHash = name; }; // a hash table shared by the threads and processes using name
+    void SetTablebasePath(const string& dir) { tablebasePath = dir; }; // "" : no tablebases
+    long long Run(istream& in, ostream& out); // returns the positions read
+
+private:
+    int threads;
+    int depth;
+    double seconds;
+    size_t hashSize;
+    int multiPV;
+    string sharedHash;
+    string tablebasePath;
+};
+
+#endif /* analysis_h */
@@ -0,0 +1,72 @@
+//
+//  async_search.cpp
+//
+
+#include <chrono>
+#include "async_search.h"
+
+AsyncSearch::~AsyncSearch()
+{
+    Stop();
+    if (worker.joinable())
+        worker.join();
+}
+
+bool AsyncSearch::Start(Turn turn, double seconds, ProgressCallback onDone)
+{
+    {
+        lock_guard<mutex> guard(lock);
+        if (running)
+            return false;
+        running = true;
+    }
+    if (worker.joinable())
+        worker.join();
+    engine.ResetStop();
+    if (seconds > 0)
+        engine.SetDeadline(seconds);
+    worker = thread(&AsyncSearch::Run, this, turn, onDone);
+    return true;
+}
+
+void AsyncSearch::Run(Turn turn, ProgressCallback onDone)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    Action a = engine.CalculateNextAction(turn);
+    SearchResult r = engine.GetProgress(); // of the last depth completed
+    r.action = a;
+    r.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (onDone)
+        onDone(r);
+    lock_guard<mutex> guard(lock);
+    engine.ResetStop(); // a Stop() which came too late
+    result = r;
+    running = false;
+    ended.notify_all();
+}
+
+void AsyncSearch::Stop()
+{
+    lock_guard<mutex> guard(lock);
+    if (running)
+        engine.Stop();
+}
+
+bool AsyncSearch::IsRunning()
+{
+    lock_guard<mutex> guard(lock);
+    return running;
+}
+
+SearchResult AsyncSearch::Wait()
+{
+    unique_lock<mutex> guard(lock);
+    ended.wait(guard, [this]() { return !running; });
+    return result;
+}
+
+bool AsyncSearch::WaitFor(double seconds)
+{
+    unique_lock<mutex> guard(lock);
+    return ended.wait_for(guard, chrono::duration<double>(seconds), [this]() { return !running; });
+}
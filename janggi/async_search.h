@@ -0,0 +1,48 @@
+//
+//  async_search.h
+//
+
+#ifndef async_search_h
+#define async_search_h
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "defines.h"
+#include "janggi.h"
+
+// Runs Janggi::CalculateNextAction on a thread of its own. The search can
+// be stopped from any thread, and ends soon with its best so far : after
+// the first depth of alpha-beta, after the running batch of MCTS. Nothing
+// else may use the engine until the search is over.
+//
+//   AsyncSearch search(engine);
+//   search.Start(turn);
+//   if (!search.WaitFor(0.5))
+//       search.Stop();
+//   Action a = search.Wait().action;
+class AsyncSearch {
+public:
+    AsyncSearch(Janggi& engine) : engine(engine), running(false) {};
+    ~AsyncSearch(); // stops and waits
+    bool Start(Turn turn, double seconds = 0.0, ProgressCallback onDone = nullptr); // false if a search is running. seconds <= 0 : no time limit
+    void Stop();
+    bool IsRunning();
+    SearchResult GetCurrent() { return engine.GetProgress(); }; // best so far
+    SearchResult Wait(); // the final result
+    bool WaitFor(double seconds); // true if the search ended
+
+private:
+    AsyncSearch(const AsyncSearch&);
+    AsyncSearch& operator=(const AsyncSearch&);
+    void Run(Turn turn, ProgressCallback onDone);
+
+    Janggi& engine;
+    thread worker;
+    mutex lock;
+    condition_variable ended;
+    bool running;
+    SearchResult result;
+};
+
+#endif /* async_search_h */
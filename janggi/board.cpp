@@ -5,12 +5,52 @@
 //
 
 #include <cstring>
+#include <cctype>
 #include <iostream>
 #include <cassert>
 #include "board.h"
 #include "pos.h"
 #include "action.h"
 #include "node.h"
+#include "zobrist.h"
+#include "eval.h"
+#include "trace.h"
+
+static bool IsInside(int x, int y)
+{
+    return x >= 0 && x < kStageWidth && y >= 0 && y < kStageHeight;
+}
+
+static bool IsInPalace(int x, int y)
+{
+    return x >= 3 && x <= 5 && ((y >= 0 && y <= 2) || (y >= 7 && y <= 9));
+}
+
+// corners and center of a palace, where the diagonal lines meet.
+static bool IsPalaceDiagonalPoint(int x, int y)
+{
+    if (!IsInPalace(x, y))
+        return false;
+    int lx = x - 3, ly = (y <= 2 ? y : y - 7);
+    return (lx != 1 && ly != 1) || (lx == 1 && ly == 1);
+}
+
+// orthogonal directions of chariots and cannons
+static const int kLines[4][2] = { {0, -1}, {0, 1}, {1, 0}, {-1, 0} };
+
+// horses : one orthogonal step (the leg) then one diagonal step.
+// move dx, dy, then leg dx, dy from the horse.
+static const int kMa[8][4] = {
+    {1, -2, 0, -1}, {-1, -2, 0, -1}, {1, 2, 0, 1}, {-1, 2, 0, 1},
+    {2, 1, 1, 0}, {2, -1, 1, 0}, {-2, 1, -1, 0}, {-2, -1, -1, 0},
+};
+
+// elephants : one orthogonal step then two diagonal steps.
+// move dx, dy, then both legs from the elephant.
+static const int kSang[8][6] = {
+    {2, -3, 0, -1, 1, -2}, {-2, -3, 0, -1, -1, -2}, {2, 3, 0, 1, 1, 2}, {-2, 3, 0, 1, -1, 2},
+    {3, -2, 1, 0, 2, -1}, {3, 2, 1, 0, 2, 1}, {-3, -2, -1, 0, -2, -1}, {-3, 2, -1, 0, -2, 1},
+};
 
 Board::Board() {
     Init();
@@ -24,14 +64,26 @@ Board::Board(Board const &b) {
     memcpy(stage, b.stage, sizeof(int)*kStageHeight*kStageWidth);
 }
 
-void Board::DoAction(Action action) {
+Board& Board::operator=(Board const &b) {
+    memmove(stage, b.stage, sizeof(int)*kStageHeight*kStageWidth);
+    return *this;
+}
+
+int Board::DoAction(Action action) {
     if (stage[action.prev.y][action.prev.x] < 0) {
         throw;
     }
     
     //action.Print();
+    int captured = stage[action.next.y][action.next.x];
     stage[action.next.y][action.next.x] = stage[action.prev.y][action.prev.x];
     stage[action.prev.y][action.prev.x] = -1;
+    return captured;
+}
+
+void Board::UndoAction(Action action, int captured) {
+    stage[action.prev.y][action.prev.x] = stage[action.next.y][action.next.x];
+    stage[action.next.y][action.next.x] = captured;
 }
 
 int Board::GetValue() {
@@ -39,36 +91,346 @@ int Board::GetValue() {
     //if return value is 0, the score is tied
     //if return value is positive, cho is ahead of han
     //if return value is negative, han is ahead of cho
-    int score_cho = 0, score_han = 0;
-    
+    //a missing general is a decided game : +-kWinValue
+    TRACE_SCOPE("GetValue");
+    return EvaluateStage(stage);
+}
+
+uint64_t Board::GetHash(Turn turn)
+{
+    uint64_t hash = (turn == TURN_HAN ? ZobristTurnKey() : 0);
     for (int y=0 ; y<kStageHeight ; y++) {
         for (int x=0 ; x<kStageWidth ; x++) {
-            int val = stage[y][x];            
-            if (val >= 0) {
-                if (val <= 6)
-                    score_han += POINT[val];
-                else
-                    score_cho += POINT[val-7];
-            }
+            if (stage[y][x] >= 0)
+                hash ^= ZobristUnitKey(stage[y][x], x, y);
         }
-    }    
-    return score_cho - score_han;
+    }
+    return hash;
+}
+
+uint64_t Board::UpdateHash(uint64_t hash, Action action)
+{
+    int unit = stage[action.prev.y][action.prev.x];
+    int captured = stage[action.next.y][action.next.x];
+    hash ^= ZobristTurnKey();
+    hash ^= ZobristUnitKey(unit, action.prev.x, action.prev.y);
+    hash ^= ZobristUnitKey(unit, action.next.x, action.next.y);
+    if (captured >= 0)
+        hash ^= ZobristUnitKey(captured, action.next.x, action.next.y);
+    return hash;
 }
 
 vector<Action> Board::GetPossibleActions(Turn turn)
 {
-    vector<Action> actions;
-    for (int y=0 ; y<kStageHeight ; y++) {
-        for (int x=0 ; x<kStageWidth ; x++) {
-            if ( IsMovableUnit(stage[y][x], turn) ) {
-                Pos curr(x,y);
-                vector<Pos> candidates = GetMovableCanditates(curr);
-                for (Pos p : candidates)
-                    actions.push_back(Action(curr, p));
+    ActionList actions;
+    GetPossibleActions(turn, GEN_ALL, actions);
+    return vector<Action>(actions.actions, actions.actions + actions.size);
+}
+
+// appends to actions
+void Board::GetPossibleActions(Turn turn, GenType gen, ActionList& actions)
+{
+    TRACE_SCOPE("GetPossibleActions");
+    if (turn == TURN_CHO) {
+        switch (gen) {
+            case GEN_ALL: GenerateActions<TURN_CHO, GEN_ALL>(actions); break;
+            case GEN_CAPTURES: GenerateActions<TURN_CHO, GEN_CAPTURES>(actions); break;
+            case GEN_QUIETS: GenerateActions<TURN_CHO, GEN_QUIETS>(actions); break;
+        }
+    }
+    else {
+        switch (gen) {
+            case GEN_ALL: GenerateActions<TURN_HAN, GEN_ALL>(actions); break;
+            case GEN_CAPTURES: GenerateActions<TURN_HAN, GEN_CAPTURES>(actions); break;
+            case GEN_QUIETS: GenerateActions<TURN_HAN, GEN_QUIETS>(actions); break;
+        }
+    }
+}
+
+vector<Action> Board::GetLegalActions(Turn turn)
+{
+    ActionList actions;
+    GetPossibleActions(turn, GEN_ALL, actions);
+    CheckInfo info;
+    GetCheckInfo(turn, info);
+    vector<Action> legal;
+    legal.reserve(actions.size);
+    for (int i = 0; i < actions.size; i++) {
+        if (IsLegalAction(actions[i], turn, info))
+            legal.push_back(actions[i]);
+    }
+    return legal;
+}
+
+void Board::GetCheckInfo(Turn turn, CheckInfo& info)
+{
+    memset(info.sensitive, 0, sizeof(info.sensitive));
+    info.general = FindGeneral(turn);
+    info.inCheck = false;
+    Pos g = info.general;
+    if (g.x < 0)
+        return;
+    info.inCheck = IsAttacked(g, turn == TURN_CHO ? TURN_HAN : TURN_CHO);
+
+    // lines of chariots and cannons
+    for (int x = 0; x < kStageWidth; x++)
+        info.sensitive[g.y][x] = true;
+    for (int y = 0; y < kStageHeight; y++)
+        info.sensitive[y][g.x] = true;
+    for (int dy = -1; dy <= 1; dy += 2) {
+        for (int dx = -1; dx <= 1; dx += 2) {
+            // diagonals of the palace
+            if (IsPalaceDiagonalPoint(g.x, g.y)) {
+                for (int x = g.x + dx, y = g.y + dy; IsInPalace(x, y); x += dx, y += dy)
+                    info.sensitive[y][x] = true;
+            }
+            // legs of horses (1 step) and elephants (1 and 2 steps)
+            for (int k = 1; k <= 2; k++) {
+                if (IsInside(g.x + k * dx, g.y + k * dy))
+                    info.sensitive[g.y + k * dy][g.x + k * dx] = true;
+            }
+        }
+    }
+}
+
+// A pseudo-legal action is legal unless it leaves the general attacked.
+// Only actions of the general, actions while in check and actions touching
+// a sensitive square need to be tried.
+bool Board::IsLegalAction(Action action, Turn turn, const CheckInfo& info)
+{
+    if (info.general.x < 0)
+        return true;
+    bool moveGeneral = (action.prev.x == info.general.x && action.prev.y == info.general.y);
+    if (!info.inCheck && !moveGeneral &&
+        !info.sensitive[action.prev.y][action.prev.x] && !info.sensitive[action.next.y][action.next.x])
+        return true;
+
+    int unit = stage[action.prev.y][action.prev.x];
+    int captured = stage[action.next.y][action.next.x];
+    stage[action.next.y][action.next.x] = unit;
+    stage[action.prev.y][action.prev.x] = -1;
+    bool safe = !IsAttacked(moveGeneral ? action.next : info.general, turn == TURN_CHO ? TURN_HAN : TURN_CHO);
+    stage[action.prev.y][action.prev.x] = unit;
+    stage[action.next.y][action.next.x] = captured;
+    return safe;
+}
+
+// Works backwards from pos : looks for a unit of side at every place it
+// could attack pos from. Stops at the first one unless collect is set, in
+// which case every attacker is written to attackers.
+template <bool collect>
+int Board::FindAttackers(Pos pos, Turn side, Pos* attackers)
+{
+    int count = 0;
+    int base = (side == TURN_CHO ? CG : HG);
+    int gung = base, cha = base + 1, ma = base + 2, sang = base + 3;
+    int po = base + 4, sa = base + 5, jol = base + 6;
+    if (stage[pos.y][pos.x] == HP || stage[pos.y][pos.x] == CP)
+        po = -2; // a cannon can not capture a cannon
+
+    // chariots, and cannons behind exactly one screen
+    for (int d = 0; d < 4; d++) {
+        int dx = kLines[d][0], dy = kLines[d][1];
+        int x = pos.x + dx, y = pos.y + dy;
+        while (IsInside(x, y) && stage[y][x] < 0) {
+            x += dx;
+            y += dy;
+        }
+        if (!IsInside(x, y))
+            continue;
+        if (stage[y][x] == cha) {
+            if (!collect)
+                return 1;
+            attackers[count++] = Pos(x, y); // a cannon behind may use it as a screen
+        }
+        if (stage[y][x] == HP || stage[y][x] == CP) // a cannon can not jump over a cannon
+            continue;
+        x += dx;
+        y += dy;
+        while (IsInside(x, y) && stage[y][x] < 0) {
+            x += dx;
+            y += dy;
+        }
+        if (IsInside(x, y) && stage[y][x] == po) {
+            if (!collect)
+                return 1;
+            attackers[count++] = Pos(x, y);
+        }
+    }
+
+    // the same along the diagonals of the palace
+    if (IsPalaceDiagonalPoint(pos.x, pos.y)) {
+        for (int dy = -1; dy <= 1; dy += 2) {
+            for (int dx = -1; dx <= 1; dx += 2) {
+                int x1 = pos.x + dx, y1 = pos.y + dy;
+                if (!IsInPalace(x1, y1))
+                    continue;
+                int first = stage[y1][x1];
+                if (first == cha) {
+                    if (!collect)
+                        return 1;
+                    attackers[count++] = Pos(x1, y1);
+                }
+                int x2 = x1 + dx, y2 = y1 + dy;
+                if (!IsInPalace(x2, y2))
+                    continue;
+                int second = stage[y2][x2];
+                if ((first < 0 && second == cha) || (first >= 0 && first != HP && first != CP && second == po)) {
+                    if (!collect)
+                        return 1;
+                    attackers[count++] = Pos(x2, y2);
+                }
+            }
+        }
+    }
+
+    // horses
+    for (int i = 0; i < 8; i++) {
+        int hx = pos.x - kMa[i][0], hy = pos.y - kMa[i][1];
+        if (IsInside(hx, hy) && stage[hy][hx] == ma && stage[hy + kMa[i][3]][hx + kMa[i][2]] < 0) {
+            if (!collect)
+                return 1;
+            attackers[count++] = Pos(hx, hy);
+        }
+    }
+
+    // elephants
+    for (int i = 0; i < 8; i++) {
+        int ex = pos.x - kSang[i][0], ey = pos.y - kSang[i][1];
+        if (IsInside(ex, ey) && stage[ey][ex] == sang &&
+            stage[ey + kSang[i][3]][ex + kSang[i][2]] < 0 && stage[ey + kSang[i][5]][ex + kSang[i][4]] < 0) {
+            if (!collect)
+                return 1;
+            attackers[count++] = Pos(ex, ey);
+        }
+    }
+
+    // soldiers : forward, sideways, and forward along the diagonals of the palace
+    int forward = (side == TURN_CHO ? -1 : 1);
+    if (IsInside(pos.x, pos.y - forward) && stage[pos.y - forward][pos.x] == jol) {
+        if (!collect)
+            return 1;
+        attackers[count++] = Pos(pos.x, pos.y - forward);
+    }
+    for (int dx = -1; dx <= 1; dx += 2) {
+        if (IsInside(pos.x + dx, pos.y) && stage[pos.y][pos.x + dx] == jol) {
+            if (!collect)
+                return 1;
+            attackers[count++] = Pos(pos.x + dx, pos.y);
+        }
+        int sx = pos.x + dx, sy = pos.y - forward;
+        if (IsInPalace(pos.x, pos.y) && IsPalaceDiagonalPoint(sx, sy) && stage[sy][sx] == jol) {
+            if (!collect)
+                return 1;
+            attackers[count++] = Pos(sx, sy);
+        }
+    }
+
+    // general and guards : one step inside the palace
+    if (IsInPalace(pos.x, pos.y)) {
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                int nx = pos.x + dx, ny = pos.y + dy;
+                if ((dx == 0 && dy == 0) || !IsInPalace(nx, ny))
+                    continue;
+                if (dx != 0 && dy != 0 && !IsPalaceDiagonalPoint(nx, ny))
+                    continue;
+                if (stage[ny][nx] == gung || stage[ny][nx] == sa) {
+                    if (!collect)
+                        return 1;
+                    attackers[count++] = Pos(nx, ny);
+                }
             }
         }
     }
-    return actions;
+    return count;
+}
+
+bool Board::IsAttacked(Pos pos, Turn side)
+{
+    return FindAttackers<false>(pos, side, NULL) > 0;
+}
+
+// at most two of each kind, the general aside
+int Board::GetAttackers(Pos pos, Turn side, Pos* attackers)
+{
+    return FindAttackers<true>(pos, side, attackers);
+}
+
+// the general has no material value, but taking it ends the game.
+int Board::GetUnitValue(int unitID)
+{
+    int kind = unitID > 6 ? unitID - CG : unitID;
+    return kind == HG ? kSeeGeneralValue : POINT[kind];
+}
+
+// Static exchange evaluation : material won by the side playing action when
+// both sides keep recapturing on its target with their least valuable
+// attacker, and may stop whenever that is better. The attackers are looked
+// up again on the board after each capture, so that a chariot behind a
+// chariot, or a cannon which just gained or lost its screen, is counted.
+// Pins are not considered.
+int Board::See(Action action)
+{
+    Board b(*this);
+    Pos target = action.next;
+    Pos from = action.prev;
+    int attacker = b.stage[from.y][from.x];
+    int captured = b.stage[target.y][target.x];
+    Turn side = attacker > 6 ? TURN_CHO : TURN_HAN;
+    int gain[kMaxExchange];
+    int d = 0;
+    gain[0] = captured >= 0 ? GetUnitValue(captured) : 0;
+    Pos attackers[kMaxAttackers];
+    do {
+        d++;
+        gain[d] = GetUnitValue(attacker) - gain[d - 1]; // if it is taken back
+        b.DoAction(Action(from, target));
+        side = (side == TURN_CHO ? TURN_HAN : TURN_CHO);
+        int n = b.GetAttackers(target, side, attackers);
+        from = Pos();
+        int best = INT_MAX;
+        for (int i = 0; i < n; i++) {
+            int v = GetUnitValue(b.stage[attackers[i].y][attackers[i].x]);
+            if (v < best) {
+                best = v;
+                from = attackers[i];
+            }
+        }
+        if (from.x >= 0)
+            attacker = b.stage[from.y][from.x];
+    } while (from.x >= 0 && d < kMaxExchange - 1);
+
+    while (--d)
+        gain[d - 1] = -max(-gain[d - 1], gain[d]);
+    return gain[0];
+}
+
+bool Board::IsInCheck(Turn turn)
+{
+    Pos general = FindGeneral(turn);
+    return general.x >= 0 && IsAttacked(general, turn == TURN_CHO ? TURN_HAN : TURN_CHO);
+}
+
+Pos Board::FindGeneral(Turn turn)
+{
+    int general = (turn == TURN_CHO ? CG : HG);
+    int top = (turn == TURN_CHO ? 7 : 0);
+    for (int y = top; y < top + 3; y++) {
+        for (int x = 3; x <= 5; x++) {
+            if (stage[y][x] == general)
+                return Pos(x, y);
+        }
+    }
+    return Pos();
+}
+
+// value of a position where turn has no legal action : checkmate, or a draw.
+int Board::GetNoActionValue(Turn turn)
+{
+    if (!IsInCheck(turn))
+        return 0;
+    return turn == TURN_CHO ? -kWinValue : kWinValue;
 }
 
 bool Board::IsMovableUnit(int unitID, int turn)
@@ -155,563 +517,307 @@ string Board::ToString(Pos sharpPosition) {  // TODO : -1 = magic number.
     return s;
 }
 
+// Placement and player to move as in FEN, from the top row (han's home)
+// down : "rnba1abnr/4k4/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/4K4/RNBA1ABNR w".
+// 'w' is cho, 'b' is han.
+string Board::ToFEN(Turn turn)
+{
+    string s;
+    for (int y = 0; y < kStageHeight; y++) {
+        int empty = 0;
+        for (int x = 0; x < kStageWidth; x++) {
+            int id = stage[y][x];
+            if (id < 0) {
+                empty++;
+                continue;
+            }
+            if (empty > 0)
+                s += (char)('0' + empty);
+            empty = 0;
+            s += (id > 6 ? kUnitLetters[id - CG] : (char)tolower(kUnitLetters[id - HG]));
+        }
+        if (empty > 0)
+            s += (char)('0' + empty);
+        if (y != kStageHeight - 1)
+            s += '/';
+    }
+    s += (turn == TURN_CHO ? " w" : " b");
+    return s;
+}
+
+// the fields after the player to move are ignored. the board is left
+// unchanged on error.
+bool Board::SetFromFEN(const string& fen, Turn& turn)
+{
+    int s[kStageHeight][kStageWidth];
+    int x = 0, y = 0;
+    size_t i = 0;
+    for (; i < fen.size() && fen[i] != ' '; i++) {
+        char c = fen[i];
+        if (c == '/') {
+            if (x != kStageWidth || ++y >= kStageHeight)
+                return false;
+            x = 0;
+        }
+        else if (c >= '1' && c <= '9') {
+            for (int k = c - '0'; k > 0; k--) {
+                if (x >= kStageWidth)
+                    return false;
+                s[y][x++] = -1;
+            }
+        }
+        else {
+            const char* p = strchr(kUnitLetters, toupper(c));
+            if (p == NULL || *p == '\0' || x >= kStageWidth)
+                return false;
+            s[y][x++] = (int)(p - kUnitLetters) + (isupper(c) ? CG : HG);
+        }
+    }
+    if (x != kStageWidth || y != kStageHeight - 1)
+        return false;
+    while (i < fen.size() && fen[i] == ' ')
+        i++;
+    if (i < fen.size() && fen[i] != 'w' && fen[i] != 'b')
+        return false;
+    turn = (i < fen.size() && fen[i] == 'b') ? TURN_HAN : TURN_CHO;
+    memcpy(stage, s, sizeof(stage));
+    return true;
+}
+
 vector<Pos> Board::GetMovableCanditates(Pos pos)
 {
-  vector<Pos> candidates;
-    switch(stage[pos.y][pos.x]) {
+    ActionList actions;
+    GetUnitActions(pos, actions);
+    vector<Pos> candidates;
+    for (int i = 0; i < actions.size; i++)
+        candidates.push_back(actions[i].next);
+    return candidates;
+}
+
+void Board::GetUnitActions(Pos pos, ActionList& actions)
+{
+    int id = stage[pos.y][pos.x];
+    if (id < 0)
+        throw;
+    if (id > 6)
+        GenerateUnitActions<TURN_CHO, GEN_ALL>(pos, id - CG, actions);
+    else
+        GenerateUnitActions<TURN_HAN, GEN_ALL>(pos, id - HG, actions);
+}
+
+// is action one of the pseudo-legal actions of turn. used to validate
+// actions coming from a hash table or a killer slot.
+bool Board::IsPossibleAction(Action action, Turn turn)
+{
+    if (action.IsNull() || !IsMovableUnit(stage[action.prev.y][action.prev.x], turn))
+        return false;
+    ActionList actions;
+    GetUnitActions(action.prev, actions);
+    for (int i = 0; i < actions.size; i++) {
+        if (actions[i] == action)
+            return true;
+    }
+    return false;
+}
+
+// The generators below are specialized on the side to move, so that the
+// friend-or-foe tests and the direction of the soldiers are constants.
+
+// can a unit of turn move to a square holding id : empty or enemy.
+// -1 (empty) is the largest unsigned value, so both tests are one comparison.
+template <Turn turn>
+static inline bool IsTarget(int id)
+{
+    return turn == TURN_CHO ? id <= 6 : (unsigned)id > 6u;
+}
+
+template <Turn turn>
+static inline bool IsEnemy(int id)
+{
+    return turn == TURN_CHO ? (unsigned)id <= 6u : id > 6;
+}
+
+// keeps the actions asked for : all of them, captures only or quiet only.
+template <GenType gen>
+static inline void AddAction(ActionList& actions, Pos pos, int nx, int ny, int target)
+{
+    if (gen == GEN_ALL || (gen == GEN_CAPTURES) == (target >= 0))
+        actions.push_back(Action(pos, Pos(nx, ny)));
+}
+
+template <Turn turn, GenType gen>
+void Board::GenerateActions(ActionList& actions)
+{
+    const int base = (turn == TURN_CHO ? CG : HG);
+    for (int y = 0; y < kStageHeight; y++) {
+        for (int x = 0; x < kStageWidth; x++) {
+            int kind = stage[y][x] - base;
+            if ((unsigned)kind > 6u) // empty, or not ours
+                continue;
+            GenerateUnitActions<turn, gen>(Pos(x, y), kind, actions);
+        }
+    }
+}
+
+// kind : unit id relative to the general of turn (HG..HJ order)
+template <Turn turn, GenType gen>
+void Board::GenerateUnitActions(Pos pos, int kind, ActionList& actions)
+{
+    switch (kind) {
         case HG:
-        case CG:
         case Hs:
-        case Cs:
-          candidates = MoveGung(pos);
-          break;
+            MoveGung<turn, gen>(pos, actions);
+            break;
         case HC:
-        case CC:
-          candidates = MoveCha(pos);
-          break;
+            MoveCha<turn, gen>(pos, actions);
+            break;
         case HM:
-        case CM:
-          candidates = MoveMa(pos);
-          break;
+            MoveMa<turn, gen>(pos, actions);
+            break;
         case HS:
-        case CS:
-          candidates = MoveSang(pos);
-          break;
+            MoveSang<turn, gen>(pos, actions);
+            break;
         case HP:
-        case CP:
-          candidates = MovePo(pos);
-          break;
+            MovePo<turn, gen>(pos, actions);
+            break;
         case HJ:
-        case CJ:
-          candidates = MoveJol(pos);
-          break;
-        default:
-            throw;
-    }
-
-    // Remove redundancy
-    vector<Pos> results;
-    for (int i = 0; i < candidates.size(); i++) {
-      bool isUnique = true;
-      Pos candidate = candidates[i];
-      for (int s = 0; s < i - 1; s++) {
-        if (candidate.x == candidates[s].x && candidate.y == candidates[s].y) {
-          isUnique = false;
-          break;
-        }
-      }
-      if (isUnique)
-        results.push_back(candidate);
+            MoveJol<turn, gen>(pos, actions);
+            break;
     }
-
-    return results;
 }
 
-vector<Pos> Board::MoveGung(Pos pos)
+template <Turn turn, GenType gen>
+void Board::MoveGung(Pos pos, ActionList& actions)
 {
-    vector<Pos> candidates;
-    int curr_id = stage[pos.y][pos.x];
-    int nx, ny;
+    bool diagonal = IsPalaceDiagonalPoint(pos.x, pos.y);
     for (int dy = -1; dy <= 1; dy++) {
         for (int dx = -1; dx <= 1; dx++) {
-            nx = pos.x + dx;
-            ny = pos.y + dy;
-            if ((pos.x == 3 && (pos.y == 1 || pos.y == 8)) ||
-                (pos.x == 4 && (pos.y == 0 || pos.y == 2 || pos.y == 7 || pos.y == 9)) ||
-                (pos.x == 5 && (pos.y == 1 || pos.y == 8))) {
-                // movable to only up, right, left, down side
-                if (pos.DistWith(nx, ny) > 1)
-                    continue;
-            }
-            if (nx >= 3 && nx <= 5
-                && ((ny >= 0 && ny <= 2) || (ny >= 7 && ny <= 9))) {
-                if (curr_id <= 6) {
-                    if (stage[ny][nx]<0 || stage[ny][nx]>6) {
-                        candidates.push_back(Pos(nx, ny));
-                    }
-                }
-                else {
-                    if (stage[ny][nx]<0 || stage[ny][nx] <= 6) {
-                        candidates.push_back(Pos(nx, ny));
-                    }
-                }
-            }
+            if (dx != 0 && dy != 0 && !diagonal) // only up, right, left, down
+                continue;
+            int nx = pos.x + dx, ny = pos.y + dy;
+            if ((dx != 0 || dy != 0) && IsInPalace(nx, ny) && IsTarget<turn>(stage[ny][nx]))
+                AddAction<gen>(actions, pos, nx, ny, stage[ny][nx]);
         }
     }
-    
-    return candidates;
 }
 
-vector<Pos> Board::MoveCha(Pos pos)
+template <Turn turn, GenType gen>
+void Board::MoveCha(Pos pos, ActionList& actions)
 {
-    int curr_id = stage[pos.y][pos.x];
-    vector<Pos> candidates;
-    
-    // up
-    if (pos.y>0) {
-        for (int y = pos.y - 1; y >= 0; y--) {
-            if (curr_id <= 6) {
-                if (stage[y][pos.x] < 0) {
-                    candidates.push_back(Pos(pos.x, y));
-                }
-                else {
-                    if (stage[y][pos.x] > 6) {
-                        candidates.push_back(Pos(pos.x, y));
-                    }
-                    break;
-                }
-            }
-            else {
-                if (stage[y][pos.x] < 0) {
-                    candidates.push_back(Pos(pos.x, y));
-                }
-                else {
-                    if (stage[y][pos.x] <= 6) {
-                        candidates.push_back(Pos(pos.x, y));
-                    }
-                    break;
-                }
-            }
-        }
-    }
-    // down
-    if (pos.y<kStageHeight - 1) {
-        for (int y = pos.y + 1; y < kStageHeight; y++) {
-            if (curr_id <= 6) {
-                if (stage[y][pos.x] < 0) {
-                    candidates.push_back(Pos(pos.x, y));
-                }
-                else {
-                    if (stage[y][pos.x] > 6) {
-                        candidates.push_back(Pos(pos.x, y));
-                    }
-                    break;
-                }
-            }
-            else {
-                if (stage[y][pos.x] < 0) {
-                    candidates.push_back(Pos(pos.x, y));
-                }
-                else {
-                    if (stage[y][pos.x] <= 6) {
-                        candidates.push_back(Pos(pos.x, y));
-                    }
-                    break;
-                }
-            }
-        }
-    }
-    // right
-    if (pos.x<kStageWidth - 1) {
-        for (int x = pos.x + 1; x < kStageWidth; x++) {
-            if (curr_id <= 6) {
-                if (stage[pos.y][x] < 0) {
-                    candidates.push_back(Pos(x, pos.y));
-                }
-                else {
-                    if (stage[pos.y][x] > 6) {
-                        candidates.push_back(Pos(x, pos.y));
-                    }
-                    break;
-                }
-            }
-            else {
-                if (stage[pos.y][x] < 0) {
-                    candidates.push_back(Pos(x, pos.y));
-                }
-                else {
-                    if (stage[pos.y][x] <= 6) {
-                        candidates.push_back(Pos(x, pos.y));
-                    }
-                    break;
-                }
-            }
-        }
-    }
-    // left
-    if (pos.x>0) {
-        for (int x = pos.x - 1; x >= 0; x--) {
-            if (curr_id <= 6) {
-                if (stage[pos.y][x] < 0) {
-                    candidates.push_back(Pos(x, pos.y));
-                }
-                else {
-                    if (stage[pos.y][x] > 6) {
-                        candidates.push_back(Pos(x, pos.y));
-                    }
-                    break;
-                }
-            }
-            else {
-                if (stage[pos.y][x] < 0) {
-                    candidates.push_back(Pos(x, pos.y));
-                }
-                else {
-                    if (stage[pos.y][x] <= 6) {
-                        candidates.push_back(Pos(x, pos.y));
-                    }
-                    break;
-                }
+    for (int d = 0; d < 4; d++) {
+        int dx = kLines[d][0], dy = kLines[d][1];
+        for (int nx = pos.x + dx, ny = pos.y + dy; IsInside(nx, ny); nx += dx, ny += dy) {
+            int id = stage[ny][nx];
+            if (id < 0) {
+                AddAction<gen>(actions, pos, nx, ny, stage[ny][nx]);
+                continue;
             }
+            if (IsEnemy<turn>(id))
+                AddAction<gen>(actions, pos, nx, ny, stage[ny][nx]);
+            break;
         }
     }
-    
-    // diagonal
-    if (pos.x >= 3 && pos.x <= 5
-        && ((pos.y >= 0 && pos.y <= 2) || (pos.y >= 7 && pos.y <= 9))) {
-        int nx, ny;
-        for (int dy = -1; dy <= 1; dy++) {
-            for (int dx = -1; dx <= 1; dx++) {
-                nx = pos.x + dx;
-                ny = pos.y + dy;
-                if ((pos.x == 3 && (pos.y == 1 || pos.y == 8)) ||
-                    (pos.x == 4 && (pos.y == 0 || pos.y == 2 || pos.y == 7 || pos.y == 9)) ||
-                    (pos.x == 5 && (pos.y == 1 || pos.y == 8))) {
-                    // movable to only up, right, left, down side
-                    if (pos.DistWith(nx, ny) > 1)
-                        continue;
-                }
-                if (nx >= 3 && nx <= 5
-                    && ((ny >= 0 && ny <= 2) || (ny >= 7 && ny <= 9))) {
-                    if (curr_id <= 6) {
-                        if (stage[ny][nx]<0 || stage[ny][nx]>6) {
-                            candidates.push_back(Pos(nx, ny));
-                        }
-                    }
-                    else {
-                        if (stage[ny][nx]<0 || stage[ny][nx] <= 6) {
-                            candidates.push_back(Pos(nx, ny));
-                        }
-                    }
+
+    // diagonal, along the lines of the palace
+    if (!IsPalaceDiagonalPoint(pos.x, pos.y))
+        return;
+    for (int dy = -1; dy <= 1; dy += 2) {
+        for (int dx = -1; dx <= 1; dx += 2) {
+            for (int nx = pos.x + dx, ny = pos.y + dy; IsInPalace(nx, ny); nx += dx, ny += dy) {
+                int id = stage[ny][nx];
+                if (id < 0) {
+                    AddAction<gen>(actions, pos, nx, ny, stage[ny][nx]);
+                    continue;
                 }
+                if (IsEnemy<turn>(id))
+                    AddAction<gen>(actions, pos, nx, ny, stage[ny][nx]);
+                break;
             }
         }
     }
-    
-    return candidates;
 }
 
-vector<Pos> Board::MovePo(Pos pos)
+template <Turn turn, GenType gen>
+void Board::MovePo(Pos pos, ActionList& actions)
 {
-    int curr_id = stage[pos.y][pos.x];
-    vector<Pos> candidates;
-    // up
-    if (pos.y > 1) {
-        bool movable = false;
-        for (int y = pos.y - 1; y >= 0; y--) {
-            if (movable) {
-                if (stage[y][pos.x] < 0) {
-                    candidates.push_back(Pos(pos.x, y));
-                }
-                else if (stage[y][pos.x] == HP || stage[y][pos.x] == CP) {
-                    break;
-                }
-                else {
-                    if ((curr_id<=6 && stage[y][pos.x]>6) || (curr_id>6 && stage[y][pos.x]<=6))
-                        candidates.push_back(Pos(pos.x, y));
-                    break;
-                }
-            }
-            else {
-                if (stage[y][pos.x] == HP || stage[y][pos.x] == CP) {
-                    break;
-                }
-                else if (stage[y][pos.x] > 0) {
-                    movable = true;
-                }
-            }
+    for (int d = 0; d < 4; d++) {
+        int dx = kLines[d][0], dy = kLines[d][1];
+        int nx = pos.x + dx, ny = pos.y + dy;
+        // find the screen. a cannon can not jump over a cannon.
+        while (IsInside(nx, ny) && stage[ny][nx] < 0) {
+            nx += dx;
+            ny += dy;
         }
-    }
-    
-    // down
-    if (pos.y < kStageHeight-2) {
-        bool movable = false;
-        for (int y = pos.y + 1; y <kStageHeight; y++) {
-            if (movable) {
-                if (stage[y][pos.x] < 0) {
-                    candidates.push_back(Pos(pos.x, y));
-                }
-                else if (stage[y][pos.x] == HP || stage[y][pos.x] == CP) {
-                    break;
-                }
-                else {
-                    if ((curr_id <= 6 && stage[y][pos.x]>6) || (curr_id>6 && stage[y][pos.x] <= 6))
-                        candidates.push_back(Pos(pos.x, y));
-                    break;
-                }
+        if (!IsInside(nx, ny) || stage[ny][nx] == HP || stage[ny][nx] == CP)
+            continue;
+        for (nx += dx, ny += dy; IsInside(nx, ny); nx += dx, ny += dy) {
+            int id = stage[ny][nx];
+            if (id < 0) {
+                AddAction<gen>(actions, pos, nx, ny, stage[ny][nx]);
+                continue;
             }
-            else {
-                if (stage[y][pos.x] == HP || stage[y][pos.x] == CP) {
-                    break;
-                }
-                else if (stage[y][pos.x] > 0) {
-                    movable = true;
-                }
-            }
-        }
-    }
-    
-    // right
-    if (pos.x < kStageWidth - 2) {
-        bool movable = false;
-        for (int x = pos.x + 1; x <kStageWidth; x++) {
-            if (movable) {
-                if (stage[pos.y][x] < 0) {
-                    candidates.push_back(Pos(x, pos.y));
-                }
-                else if (stage[pos.y][x] == HP || stage[pos.y][x] == CP) {
-                    break;
-                }
-                else {
-                    if ((curr_id <= 6 && stage[pos.y][x]>6) || (curr_id>6 && stage[pos.y][x] <= 6))
-                        candidates.push_back(Pos(x, pos.y));
-                    break;
-                }
-            }
-            else {
-                if (stage[pos.y][x] == HP || stage[pos.y][x] == CP) {
-                    break;
-                }
-                else if (stage[pos.y][x] > 0) {
-                    movable = true;
-                }
-            }
-        }
-    }
-    
-    // left
-    if (pos.x > 1) {
-        bool movable = false;
-        for (int x = pos.x - 1; x >= 0; x--) {
-            if (movable) {
-                if (stage[pos.y][x] < 0) {
-                    candidates.push_back(Pos(x, pos.y));
-                }
-                else if (stage[pos.y][x] == HP || stage[pos.y][x] == CP) {
-                    break;
-                }
-                else {
-                    if ((curr_id <= 6 && stage[pos.y][x]>6) || (curr_id>6 && stage[pos.y][x] <= 6))
-                        candidates.push_back(Pos(x, pos.y));
-                    break;
-                }
-            }
-            else {
-                if (stage[pos.y][x] == HP || stage[pos.y][x] == CP) {
-                    break;
-                }
-                else if (stage[pos.y][x] > 0) {
-                    movable = true;
-                }
-            }
-        }
-    }
-    
-    // diagonal
-    Pos next;
-    if (stage[4][1] > 0 && stage[4][1] != HP && stage[4][1] != CP) {
-        if (pos.x == 3 && pos.x == 0) {
-            next = Pos(5, 2);
-            if ((curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6))
-                candidates.push_back(next);
-        }
-        else if (pos.x == 3 && pos.x == 2) {
-            next = Pos(5, 0);
-            if ((curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6))
-                candidates.push_back(next);
-        }
-        else if (pos.x == 5 && pos.x == 0) {
-            next = Pos(3, 2);
-            if ((curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6))
-                candidates.push_back(next);
-        }
-        else if (pos.x == 5 && pos.x == 2) {
-            next = Pos(3, 0);
-            if ((curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6))
-                candidates.push_back(next);
+            if (id != HP && id != CP && IsEnemy<turn>(id))
+                AddAction<gen>(actions, pos, nx, ny, stage[ny][nx]);
+            break;
         }
     }
-    else if (stage[4][8] > 0 && stage[4][8] != HP && stage[4][8] != CP) {
-        if (pos.x == 3 && pos.x == 7) {
-            next = Pos(5, 9);
-            if ((curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6))
-                candidates.push_back(next);
-        }
-        else if (pos.x == 3 && pos.x == 9) {
-            next = Pos(5, 7);
-            if ((curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6))
-                candidates.push_back(next);
-        }
-        else if (pos.x == 5 && pos.x == 7) {
-            next = Pos(3, 9);
-            if ((curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6))
-                candidates.push_back(next);
-        }
-        else if (pos.x == 5 && pos.x == 9) {
-            next = Pos(3, 7);
-            if ((curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6))
-                candidates.push_back(next);
+
+    // diagonal, jumping over the center of the palace
+    if (!IsPalaceDiagonalPoint(pos.x, pos.y))
+        return;
+    for (int dy = -1; dy <= 1; dy += 2) {
+        for (int dx = -1; dx <= 1; dx += 2) {
+            int nx = pos.x + 2 * dx, ny = pos.y + 2 * dy;
+            if (!IsInPalace(nx, ny))
+                continue;
+            int screen = stage[pos.y + dy][pos.x + dx];
+            int target = stage[ny][nx];
+            if (screen < 0 || screen == HP || screen == CP || target == HP || target == CP)
+                continue;
+            if (IsTarget<turn>(target))
+                AddAction<gen>(actions, pos, nx, ny, stage[ny][nx]);
         }
     }
-    return candidates;
 }
 
-vector<Pos> Board::MoveMa(Pos pos)
+template <Turn turn, GenType gen>
+void Board::MoveMa(Pos pos, ActionList& actions)
 {
-    int curr_id = stage[pos.y][pos.x];
-    vector<Pos> candidates;
-    Pos next;
-    if (pos.y > 1) {
-        // up-left
-        next = Pos(pos.x - 1, pos.y - 2);
-        if (stage[pos.y - 1][pos.x] < 0 && next.x >= 0 && ((curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6)))
-            candidates.push_back(next);
-        // up-right
-        next = Pos(pos.x + 1, pos.y - 2);
-        if (stage[pos.y - 1][pos.x] < 0 && next.x < kStageWidth && (stage[next.y][next.x] < 0 || (curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6)))
-            candidates.push_back(next);
-    }
-    if (pos.x < kStageWidth - 2) {
-        // right-up
-        next = Pos(pos.x + 2, pos.y + 1);
-        if (stage[pos.y][pos.x + 1] < 0 && next.y <kStageHeight && (stage[next.y][next.x] < 0 || (curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6)))
-            candidates.push_back(next);
-        
-        // right-down
-        next = Pos(pos.x + 2, pos.y - 1);
-        if (stage[pos.y][pos.x + 1] < 0 && next.y >= 0 && (stage[next.y][next.x] < 0 || (curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6)))
-            candidates.push_back(next);
-    }
-    if (pos.y < kStageHeight - 2) {
-        // down-left
-        next = Pos(pos.x - 1, pos.y + 2);
-        if (stage[pos.y + 1][pos.x] < 0 && next.x >= 0 && (stage[next.y][next.x] < 0 || (curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6)))
-            candidates.push_back(next);
-        
-        // down-right
-        next = Pos(pos.x + 1, pos.y + 2);
-        if (stage[pos.y + 1][pos.x] < 0 && next.x < kStageWidth && (stage[next.y][next.x] < 0 || (curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6)))
-            candidates.push_back(next);
+    for (int i = 0; i < 8; i++) {
+        int nx = pos.x + kMa[i][0], ny = pos.y + kMa[i][1];
+        if (IsInside(nx, ny) && stage[pos.y + kMa[i][3]][pos.x + kMa[i][2]] < 0 &&
+            IsTarget<turn>(stage[ny][nx]))
+            AddAction<gen>(actions, pos, nx, ny, stage[ny][nx]);
     }
-    if (pos.x > 1) {
-        // left-up
-        next = Pos(pos.x - 2, pos.y + 1);
-        if (stage[pos.y][pos.x - 1] < 0 && next.y <kStageHeight && (stage[next.y][next.x] < 0 || (curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6)))
-            candidates.push_back(next);
-        
-        // left-down
-        next = Pos(pos.x - 2, pos.y - 1);
-        if (stage[pos.y][pos.x - 1] < 0 && next.y >= 0 && (stage[next.y][next.x] < 0 || (curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6)))
-            candidates.push_back(next);
-    }
-    return candidates;
 }
 
-vector<Pos> Board::MoveSang(Pos pos)
+template <Turn turn, GenType gen>
+void Board::MoveSang(Pos pos, ActionList& actions)
 {
-    int curr_id = stage[pos.y][pos.x];
-    vector<Pos> candidates;
-    Pos next;
-    
-    if (pos.y > 2) {
-        // up-left
-        next = Pos(pos.x - 2, pos.y - 3);
-        if (pos.x > 1 && stage[pos.y - 1][pos.x]<0 && stage[pos.y - 2][pos.x - 1] < 0
-            && (stage[next.y][next.x] < 0 || (curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6)))
-            candidates.push_back(next);
-        
-        // up-right
-        next = Pos(pos.x + 2, pos.y - 3);
-        if (pos.x < kStageWidth - 2  && stage[pos.y - 1][pos.x]<0 && stage[pos.y - 2][pos.x + 1] < 0
-            && (stage[next.y][next.x] < 0 || (curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6)))
-            candidates.push_back(next);
-    }
-    if (pos.x < kStageWidth - 3) {
-        // right-up
-        next = Pos(pos.x + 3, pos.y - 2);
-        if (pos.y > 1 && stage[pos.y][pos.x + 1]<0 && stage[pos.y - 1][pos.x + 2] < 0
-            && (stage[next.y][next.x] < 0 || (curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6)))
-            candidates.push_back(next);
-        
-        // right-down
-        next = Pos(pos.x + 3, pos.y + 2);
-        if (pos.y < kStageHeight - 2 && stage[pos.y][pos.x + 1]<0 && stage[pos.y + 1][pos.x + 2] < 0
-            && (stage[next.y][next.x] < 0 || (curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6)))
-            candidates.push_back(next);
-        
-    }
-    if (pos.y < kStageHeight - 3) {
-        // down-left
-        next = Pos(pos.x - 2, pos.y + 3);
-        if (pos.x > 1 && stage[pos.y + 1][pos.x]<0 && stage[pos.y + 2][pos.x - 1] < 0
-            && (stage[next.y][next.x] < 0 || (curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6)))
-            candidates.push_back(next);
-        
-        // down-right
-        next = Pos(pos.x + 2, pos.y + 3);
-        if (pos.x < kStageWidth - 2 && stage[pos.y + 1][pos.x]<0 && stage[pos.y + 2][pos.x + 1] < 0
-            && (stage[next.y][next.x] < 0 || (curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6)))
-            candidates.push_back(next);
+    for (int i = 0; i < 8; i++) {
+        int nx = pos.x + kSang[i][0], ny = pos.y + kSang[i][1];
+        if (IsInside(nx, ny) &&
+            stage[pos.y + kSang[i][3]][pos.x + kSang[i][2]] < 0 &&
+            stage[pos.y + kSang[i][5]][pos.x + kSang[i][4]] < 0 &&
+            IsTarget<turn>(stage[ny][nx]))
+            AddAction<gen>(actions, pos, nx, ny, stage[ny][nx]);
     }
-    if (pos.x > 2) {
-        // left-up
-        next = Pos(pos.x - 3, pos.y - 2);
-        if (pos.y > 1 && stage[pos.y][pos.x - 1]<0 && stage[pos.y - 1][pos.x - 2] < 0
-            && (stage[next.y][next.x] < 0 || (curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6)))
-            candidates.push_back(next);
-        
-        // left-down
-        next = Pos(pos.x - 3, pos.y + 2);
-        if (pos.y < kStageHeight - 2 && stage[pos.y][pos.x - 1]<0 && stage[pos.y + 1][pos.x - 2] < 0
-            && (stage[next.y][next.x] < 0 || (curr_id <= 6 && stage[next.y][next.x]>6) || (curr_id>6 && stage[next.y][next.x] <= 6)))
-            candidates.push_back(next);
-    }
-    
-    return candidates;
 }
 
-vector<Pos> Board::MoveJol(Pos pos)
+template <Turn turn, GenType gen>
+void Board::MoveJol(Pos pos, ActionList& actions)
 {
-    int curr_id = stage[pos.y][pos.x];
-    vector<Pos> candidates;
-    
-    int nx, ny;
-    // down-ward
-    //if ((curr_id <= 6 && standard_position) || curr_id >6 && !standard_position) {
-    if (curr_id <= 6) {
-        for (int dy = 0; dy <= 1; dy++) {
-            for (int dx = -1; dx <= 1; dx++) {
-                nx = pos.x + dx;
-                ny = pos.y + dy;
-                if (nx >= 0 && nx < kStageWidth && ny >= 0 && ny < kStageHeight && (stage[ny][nx] < 0 || (curr_id <= 6 && stage[ny][nx] > 6) || (curr_id > 6 && stage[ny][nx] <= 6))) {
-                    if ((pos.x == 3 && pos.y == 7 && nx == 4 && ny == 8) ||
-                        (pos.x == 5 && pos.y == 7 && nx == 4 && ny == 8) ||
-                        (pos.x == 4 && pos.y == 8 && nx == 3 && ny == 9) ||
-                        (pos.x == 4 && pos.y == 8 && nx == 5 && ny == 9) || pos.DistWith(nx, ny) <= 1.1) {
-                        candidates.push_back(Pos(nx, ny));
-                    }
-                }
-            }
-        }
+    // cho goes up, han goes down
+    const int forward = (turn == TURN_CHO ? -1 : 1);
+    int ny = pos.y + forward;
+    if (ny >= 0 && ny < kStageHeight && IsTarget<turn>(stage[ny][pos.x]))
+        AddAction<gen>(actions, pos, pos.x, ny, stage[ny][pos.x]);
+    for (int dx = -1; dx <= 1; dx += 2) {
+        int nx = pos.x + dx;
+        if (nx >= 0 && nx < kStageWidth && IsTarget<turn>(stage[pos.y][nx]))
+            AddAction<gen>(actions, pos, nx, pos.y, stage[pos.y][nx]);
+        // forward along the diagonals of the enemy palace
+        if (IsPalaceDiagonalPoint(pos.x, pos.y) && IsInPalace(nx, ny) && IsTarget<turn>(stage[ny][nx]))
+            AddAction<gen>(actions, pos, nx, ny, stage[ny][nx]);
     }
-    // up-ward
-    else {
-        for (int dy = -1; dy <= 0; dy++) {
-            for (int dx = -1; dx <= 1; dx++) {
-                nx = pos.x + dx;
-                ny = pos.y + dy;
-                if (nx >= 0 && nx < kStageWidth && ny >= 0 && ny < kStageHeight && (stage[ny][nx] < 0 || (curr_id <= 6 && stage[ny][nx] > 6) || (curr_id > 6 && stage[ny][nx] <= 6))) {
-                    if ((pos.x == 3 && pos.y == 2 && nx == 4 && ny == 1) ||
-                        (pos.x == 5 && pos.y == 2 && nx == 4 && ny == 1) ||
-                        (pos.x == 4 && pos.y == 1 && nx == 3 && ny == 0) ||
-                        (pos.x == 4 && pos.y == 1 && nx == 5 && ny == 0) || pos.DistWith(nx, ny) <= 1.1) {
-                        candidates.push_back(Pos(nx, ny));
-                    }
-                }
-            }
-        }
-    }
-    return candidates;
 }
-
-
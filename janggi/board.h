@@ -8,20 +8,56 @@
 #define board_h
 
 #include <vector>
+#include <cstdint>
 #include "defines.h"
 #include "action.h"
 #include "pos.h"
 
+enum GenType {
+    GEN_ALL,
+    GEN_CAPTURES,
+    GEN_QUIETS,
+};
+
+// What the legality test of an action needs to know about a position.
+// Computed once, it spares a full test for most of the actions.
+struct CheckInfo {
+    Pos general;
+    bool inCheck;
+    bool sensitive[kStageHeight][kStageWidth]; // an occupancy change here may expose the general
+};
+
 class Board {
 public:
+    static const int kMaxAttackers = 16;
+    static const int kMaxExchange = 32;
+    static const int kSeeGeneralValue = 100; // more than all the other units together
+
     int stage[kStageHeight][kStageWidth];
 
     Board();
     Board(Board const &b);
+    Board& operator=(Board const &b);
     Board(int s[][kStageWidth]);
-    void DoAction(Action action);
+    int DoAction(Action action); // returns the unit captured, -1 if none
+    void UndoAction(Action action, int captured);
     int GetValue();
+    uint64_t GetHash(Turn turn);
+    uint64_t UpdateHash(uint64_t hash, Action action); // hash after action, call before DoAction
     vector<Action> GetPossibleActions(Turn turn);
+    void GetPossibleActions(Turn turn, GenType gen, ActionList& actions);
+    void GetUnitActions(Pos pos, ActionList& actions);
+    bool IsPossibleAction(Action action, Turn turn);
+    vector<Action> GetLegalActions(Turn turn);
+    void GetCheckInfo(Turn turn, CheckInfo& info);
+    bool IsLegalAction(Action action, Turn turn, const CheckInfo& info);
+    bool IsAttacked(Pos pos, Turn side); // is pos attacked by a unit of side
+    int GetAttackers(Pos pos, Turn side, Pos* attackers); // kMaxAttackers entries, returns the count
+    int See(Action action); // material won by the capture sequence action starts
+    static int GetUnitValue(int unitID);
+    bool IsInCheck(Turn turn);
+    Pos FindGeneral(Turn turn);
+    int GetNoActionValue(Turn turn);
     bool IsMovableUnit(int unitID, int turn);
     bool IsUnit(Pos p);
     void SetStage(StageID stage_id);
@@ -29,13 +65,20 @@ public:
     string GetUnitID(Pos pos);
     void Print();
     string ToString(Pos sharpPosition = Pos(-1,-1));
+    string ToFEN(Turn turn);
+    bool SetFromFEN(const string& fen, Turn& turn);
     vector<Pos> GetMovableCanditates(Pos pos);
-    vector<Pos> MoveGung(Pos current);
-    vector<Pos> MoveCha(Pos current);
-    vector<Pos> MovePo(Pos current);
-    vector<Pos> MoveMa(Pos current);
-    vector<Pos> MoveSang(Pos current);
-    vector<Pos> MoveJol(Pos current);
+
+    // specialized on the side to move and on the kind of actions, defined in board.cpp
+    template <bool collect> int FindAttackers(Pos pos, Turn side, Pos* attackers);
+    template <Turn turn, GenType gen> void GenerateActions(ActionList& actions);
+    template <Turn turn, GenType gen> void GenerateUnitActions(Pos pos, int kind, ActionList& actions);
+    template <Turn turn, GenType gen> void MoveGung(Pos current, ActionList& actions);
+    template <Turn turn, GenType gen> void MoveCha(Pos current, ActionList& actions);
+    template <Turn turn, GenType gen> void MovePo(Pos current, ActionList& actions);
+    template <Turn turn, GenType gen> void MoveMa(Pos current, ActionList& actions);
+    template <Turn turn, GenType gen> void MoveSang(Pos current, ActionList& actions);
+    template <Turn turn, GenType gen> void MoveJol(Pos current, ActionList& actions);
 };
 
 #endif /* board_h */
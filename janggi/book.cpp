@@ -0,0 +1,173 @@
+//
+//  book.cpp
+//
+
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include "book.h"
+#include "janggi.h"
+#include "record.h"
+
+bool OpeningBook::Open(const string& path)
+{
+    Close();
+    if (!file.Open(path))
+        return false;
+    const BookHeader* header = (const BookHeader*)file.GetData();
+    if (file.GetSize() < sizeof(BookHeader) || memcmp(header->magic, "JBK1", 4) != 0 ||
+        file.GetSize() != sizeof(BookHeader) + header->count * sizeof(BookEntry)) {
+        file.Close();
+        return false;
+    }
+    entries = (const BookEntry*)(file.GetData() + sizeof(BookHeader));
+    count = header->count;
+    return true;
+}
+
+int OpeningBook::GetMoves(Board& board, Turn turn, vector<BookEntry>& moves)
+{
+    moves.clear();
+    if (!entries)
+        return 0;
+    uint64_t key = board.GetHash(turn);
+    const BookEntry* first = lower_bound(entries, entries + count, key,
+        [](const BookEntry& e, uint64_t k) { return e.key < k; });
+    for (const BookEntry* e = first; e < entries + count && e->key == key; e++)
+        moves.push_back(*e);
+    return (int)moves.size();
+}
+
+bool OpeningBook::Probe(Board& board, Turn turn, Action& action)
+{
+    vector<BookEntry> moves;
+    if (GetMoves(board, turn, moves) == 0)
+        return false;
+
+    // a hash collision must not play an illegal move
+    CheckInfo info;
+    board.GetCheckInfo(turn, info);
+    vector<Action> actions;
+    vector<uint32_t> weights;
+    uint64_t total = 0;
+    for (const BookEntry& e : moves) {
+        Action a = Action::Unpack(e.move);
+        if (e.weight == 0 || !a.IsOnStage() || !board.IsPossibleAction(a, turn) || !board.IsLegalAction(a, turn, info))
+            continue;
+        actions.push_back(a);
+        weights.push_back(e.weight);
+        total += e.weight;
+    }
+    if (total == 0)
+        return false;
+    uint64_t r = ((uint64_t)rand() * ((uint64_t)RAND_MAX + 1) + rand()) % total;
+    for (size_t i = 0; i < actions.size(); i++) {
+        if (r < weights[i]) {
+            action = actions[i];
+            return true;
+        }
+        r -= weights[i];
+    }
+    return false;
+}
+
+void BookBuilder::Add(uint64_t key, Action action, uint32_t weight)
+{
+    uint32_t& w = weights[make_pair(key, action.Pack())];
+    w = (uint32_t)min<uint64_t>((uint64_t)w + weight, UINT32_MAX);
+}
+
+bool BookBuilder::AddGame(const string& record, int plies)
+{
+    GameRecord game;
+    return game.FromText(record) && AddGame(game, plies);
+}
+
+bool BookBuilder::AddGame(GameRecord& game, int plies)
+{
+    Board board = game.start;
+    Turn turn = game.turn;
+    vector<pair<uint64_t, Action> > moves; // added once the whole record is read
+    for (int ply = 0; ply < plies && ply < (int)game.moves.size(); ply++) {
+        Action a = game.moves[ply];
+        if (!a.IsOnStage() || !board.IsPossibleAction(a, turn))
+            return false;
+        moves.push_back(make_pair(board.GetHash(turn), a));
+        board.DoAction(a);
+        turn = (turn == TURN_CHO ? TURN_HAN : TURN_CHO);
+    }
+    for (auto& m : moves)
+        Add(m.first, m.second, 1);
+    return !moves.empty();
+}
+
+int BookBuilder::AddRecords(const string& path, int plies)
+{
+    GameRecordReader reader;
+    if (reader.Open(path)) {
+        GameView view;
+        GameRecord game;
+        int games = 0;
+        while (reader.Next(view)) {
+            view.ToRecord(game);
+            if (AddGame(game, plies))
+                games++;
+        }
+        return games;
+    }
+    ifstream in(path.c_str());
+    string line;
+    int games = 0;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        if (AddGame(line, plies))
+            games++;
+    }
+    return games;
+}
+
+// The move alpha-beta chooses at depth, for board and every position
+// reached from it within plies, whatever the moves.
+void BookBuilder::AddSearch(Janggi& engine, Board board, Turn turn, int plies, int depth)
+{
+    if (plies <= 0)
+        return;
+    SearchResult best = engine.IterativeDeepening(board, turn, depth, 0.0);
+    if (best.action.IsNull())
+        return;
+    Add(board.GetHash(turn), best.action, 1);
+
+    Turn next = (turn == TURN_CHO ? TURN_HAN : TURN_CHO);
+    vector<Action> actions = board.GetLegalActions(turn);
+    for (Action a : actions) {
+        Board child(board);
+        child.DoAction(a);
+        AddSearch(engine, child, next, plies - 1, depth);
+    }
+}
+
+bool BookBuilder::Write(const string& path)
+{
+    FILE* f = fopen(path.c_str(), "wb");
+    if (f == NULL)
+        return false;
+    BookHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "JBK1", 4);
+    header.count = weights.size();
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    // the map is ordered by key already
+    for (auto& w : weights) {
+        BookEntry e;
+        e.key = w.first.first;
+        e.move = w.first.second;
+        e.weight = w.second;
+        e.reserved = 0;
+        ok = ok && fwrite(&e, sizeof(e), 1, f) == 1;
+    }
+    return fclose(f) == 0 && ok;
+}
@@ -0,0 +1,65 @@
+//
+//  book.h
+//
+
+#ifndef book_h
+#define book_h
+
+#include <map>
+#include <vector>
+#include <cstdint>
+#include "defines.h"
+#include "board.h"
+#include "mapped_file.h"
+
+struct GameRecord;
+
+class Janggi;
+
+// One move of the book. The file is a BookHeader followed by the entries
+// sorted by key, the moves of a position being consecutive.
+struct BookEntry {
+    uint64_t key;        // Board::GetHash of the position, player to move included
+    uint32_t weight;
+    unsigned short move; // Action::Pack()
+    unsigned short reserved;
+};
+
+struct BookHeader {
+    char magic[4];  // "JBK1"
+    uint32_t reserved;
+    uint64_t count; // entries following the header
+};
+
+// Read-only opening book, mapped in memory and searched by bisection.
+class OpeningBook {
+public:
+    OpeningBook() : entries(NULL), count(0) {};
+    bool Open(const string& path);
+    void Close() { file.Close(); entries = NULL; count = 0; };
+    bool IsOpen() { return entries != NULL; };
+    int GetMoves(Board& board, Turn turn, vector<BookEntry>& moves);
+    bool Probe(Board& board, Turn turn, Action& action); // a legal move, picked by weight
+
+private:
+    MappedFile file;
+    const BookEntry* entries;
+    uint64_t count;
+};
+
+// Collects weighted moves and writes a book.
+class BookBuilder {
+public:
+    void Add(uint64_t key, Action action, uint32_t weight);
+    bool AddGame(const string& record, int plies); // a text record, see GameRecord::FromText()
+    bool AddGame(GameRecord& game, int plies);
+    int AddRecords(const string& path, int plies); // binary records or one game a line, returns the games read
+    void AddSearch(Janggi& engine, Board board, Turn turn, int plies, int depth);
+    bool Write(const string& path);
+    size_t GetSize() { return weights.size(); };
+
+private:
+    map<pair<uint64_t, unsigned short>, uint32_t> weights;
+};
+
+#endif /* book_h */
@@ -11,13 +11,51 @@ using namespace std;
 #define MINMAX_DEPTH 4
 #define ALPHA_BETA_DEPTH 6
 #define MCTS_ITERATION 300
-#define MCTS_SIMULATION_DEPTH 2
+#define MCTS_UCT_C 1.41        // exploration constant for UCT
+#define MCTS_PUCT_C 2.0        // exploration constant for PUCT
+#define MCTS_VALUE_SCALE 10.0  // material difference that maps to tanh(1)
+#define MCTS_PRIOR_TEMPERATURE 3.0
+#define MCTS_BATCH_SIZE 8      // leaves evaluated together
+#define MCTS_VIRTUAL_LOSS 1.0  // reward charged to a path while its leaf is pending
+#define MCTS_RECYCLE_FRACTION 0.25 // share of the tree reclaimed when the memory budget is hit
+#define MCTS_MIN_ITERATION 64         // no early termination before this many iterations
+#define MCTS_CONVERGENCE_WINDOW 8     // batches over which the root value must be stable
+#define MCTS_CONVERGENCE_EPSILON 0.002
+#define MCTS_PROGRESS_INTERVAL 1000 // iterations between progress reports
+#define TT_SIZE_MB 16          // default transposition table size
+#define MAX_PLY 64             // deepest alpha-beta recursion
+#define MAX_MULTI_PV 16        // lines of a multi-PV search
+#define MATE_TT_SIZE_MB 16     // proof-number table of the mate solver
+#define MATE_NODE_LIMIT 200000 // positions a mate search may visit
+#define MATE_PALACE_ATTACKS 3  // attacked points of the enemy palace before a mate is looked for
+#define TB_MAX_UNITS 6         // units of the largest tablebase, generals included
+#define TB_PATH "tb"           // directory of the tablebase files
+#define BOOK_PATH "book.bin"   // opening book
+#define BOOK_PLIES 20          // moves of a game record kept in the book
+#define TOURNAMENT_MAX_PLIES 300   // a longer game is a draw
+#define TOURNAMENT_OPENING_PLIES 4 // random moves starting each pair of games
+#define TOURNAMENT_HASH_MB 1       // table sizes of each engine of a tournament
+#define EVAL_PARAMS_PATH "eval.txt" // evaluation weights written by tune
+#define TUNE_SKIP_PLIES 8          // opening moves of a game not used by the tuner
+#define TUNE_EPOCHS 500            // gradient steps of a tuning run
+#define TUNE_RATE 0.05             // points a weight moves by at most in a step
+#define TUNE_L2 1e-7               // penalty of the squared piece-square values
+#ifndef JANGGI_TRACE
+#define JANGGI_TRACE 0             // 1 : trace points of trace.h are compiled in
+#endif
+#ifndef JANGGI_COUNT_ALLOCATIONS
+#define JANGGI_COUNT_ALLOCATIONS 0 // 1 : operator new counts allocations, reported by bench
+#endif
+#define TRACE_BUFFER_EVENTS 65536  // events kept per thread, the oldest are overwritten
+#define TRACE_PATH "trace.json"    // chrome trace written at exit
 
 
 const double EPSILON = 1e-6;
+const int kWinValue = INT_MAX - 1; // one of the generals has been captured
 
 const int     kStageWidth = 9;
 const int     kStageHeight = 10;
+const int     kStageSquares = kStageWidth * kStageHeight;
 
 enum UnitID {
   HG, HC, HM, HS, HP, Hs, HJ,
@@ -30,6 +68,9 @@ const string UnitIDChar[IDSize] = {
     "CG", "CC", "CM", "CS", "CP", "Cs", "CJ",
 };
 
+// by unit kind, HG..HJ, as in FEN : upper case for cho, lower case for han
+const char kUnitLetters[] = "KRNBCAP";
+
 enum Turn {
   TURN_CHO,
   TURN_HAN
@@ -39,6 +80,22 @@ const int POINT[IDSize/2] = {
   INT_MAX, 13, 5, 3, 7, 3, 2
 };
 
+enum MCTSPolicy {
+  MCTS_UCT,  // UCB1 applied to trees
+  MCTS_PUCT  // UCB with move priors
+};
+
+enum SearchType {
+  SEARCH_MINMAX,
+  SEARCH_ALPHA_BETA,
+  SEARCH_MCTS
+};
+
+enum MemoryPolicy {
+  MEMORY_FREEZE,  // stop expanding, keep refining the statistics of the tree
+  MEMORY_RECYCLE  // reclaim the least visited subtrees
+};
+
 enum StageID {
   MSSMSMSM,
 };
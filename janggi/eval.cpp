@@ -0,0 +1,304 @@
+//
+//  eval.cpp
+//
+//  Material plus piece-square evaluation over byte-packed boards.
+//  A packed board holds unit id + 1 per square (0 : empty), padded to
+//  kPackedCells squares, and every kernel reads one lookup table :
+//  gTable[square][code] is the signed value of the unit code on square.
+//
+
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include "eval.h"
+#include "board.h"
+
+#if (defined(__GNUC__) || defined(_MSC_VER)) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+#define EVAL_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define EVAL_TARGET_AVX2
+#else
+#define EVAL_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define EVAL_X86 0
+#endif
+
+static const int kCells = kStageHeight * kStageWidth;
+static const int kPackedCells = 96; // multiple of 8 and 16
+static const int kCodes = 16;       // IDSize + 1 codes, rounded up
+static const int kEvalChunk = 32;   // boards packed at once
+
+static EvalParams gParams;
+static int32_t gTable[kPackedCells][kCodes];
+
+static void BuildTable()
+{
+    memset(gTable, 0, sizeof(gTable));
+    for (int y = 0; y < kStageHeight; y++) {
+        for (int x = 0; x < kStageWidth; x++) {
+            int sq = y * kStageWidth + x;
+            for (int k = 0; k < IDSize / 2; k++) {
+                if (k == HG)
+                    continue;
+                gTable[sq][CG + k + 1] = gParams.material[k] + gParams.pieceSquare[k][y][x];
+                gTable[sq][HG + k + 1] = -(gParams.material[k] + gParams.pieceSquare[k][kStageHeight - 1 - y][x]);
+            }
+        }
+    }
+}
+
+static bool InitParams()
+{
+    memset(&gParams, 0, sizeof(gParams));
+    for (int k = 1; k < IDSize / 2; k++)
+        gParams.material[k] = POINT[k];
+    BuildTable();
+    SetEvalKernel(EVAL_AUTO);
+    return true;
+}
+
+const EvalParams& GetEvalParams()
+{
+    return gParams;
+}
+
+void SetEvalParams(const EvalParams& params)
+{
+    gParams = params;
+    gParams.material[HG] = 0;
+    BuildTable();
+}
+
+bool LoadEvalParams(const string& path)
+{
+    ifstream in(path.c_str());
+    if (!in)
+        return false;
+    EvalParams params;
+    memset(&params, 0, sizeof(params));
+    bool material = false;
+    bool squares[IDSize / 2] = { false };
+    string token;
+    while (in >> token) {
+        if (token == "material") {
+            for (int k = 0; k < IDSize / 2; k++)
+                in >> params.material[k];
+            material = true;
+        }
+        else if (token == "square" && in >> token && token.size() == 1) {
+            const char* letter = strchr(kUnitLetters, token[0]);
+            if (letter == NULL || *letter == '\0')
+                return false;
+            int k = (int)(letter - kUnitLetters);
+            for (int y = 0; y < kStageHeight; y++)
+                for (int x = 0; x < kStageWidth; x++)
+                    in >> params.pieceSquare[k][y][x];
+            squares[k] = true;
+        }
+        else
+            return false;
+        if (!in)
+            return false;
+    }
+    for (int k = 1; k < IDSize / 2; k++)
+        if (!squares[k])
+            return false;
+    if (!material)
+        return false;
+    SetEvalParams(params);
+    return true;
+}
+
+bool SaveEvalParams(const string& path, const EvalParams& params)
+{
+    ofstream out(path.c_str());
+    out << "material";
+    for (int k = 0; k < IDSize / 2; k++)
+        out << " " << params.material[k];
+    out << "\n";
+    for (int k = 1; k < IDSize / 2; k++) {
+        out << "square " << kUnitLetters[k] << "\n";
+        for (int y = 0; y < kStageHeight; y++) {
+            for (int x = 0; x < kStageWidth; x++)
+                out << (x > 0 ? " " : "") << params.pieceSquare[k][y][x];
+            out << "\n";
+        }
+    }
+    out.close();
+    return !out.fail();
+}
+
+static int Finish(int score, int hanGenerals, int choGenerals)
+{
+    if (hanGenerals == 0)
+        return kWinValue;
+    if (choGenerals == 0)
+        return -kWinValue;
+    return score;
+}
+
+int EvaluateStage(const int stage[][kStageWidth])
+{
+    int score = 0, hanGenerals = 0, choGenerals = 0;
+    for (int y = 0; y < kStageHeight; y++) {
+        for (int x = 0; x < kStageWidth; x++) {
+            int code = stage[y][x] + 1;
+            score += gTable[y * kStageWidth + x][code];
+            hanGenerals += (code == HG + 1);
+            choGenerals += (code == CG + 1);
+        }
+    }
+    return Finish(score, hanGenerals, choGenerals);
+}
+
+static void Pack(const Board* board, uint8_t* cells)
+{
+    const int* stage = &board->stage[0][0];
+    for (int i = 0; i < kCells; i++)
+        cells[i] = (uint8_t)(stage[i] + 1);
+    for (int i = kCells; i < kPackedCells; i++)
+        cells[i] = 0;
+}
+
+static void ScalarKernel(const uint8_t* cells, int count, int* values)
+{
+    for (int b = 0; b < count; b++, cells += kPackedCells) {
+        int score = 0, hanGenerals = 0, choGenerals = 0;
+        for (int sq = 0; sq < kCells; sq++) {
+            score += gTable[sq][cells[sq]];
+            hanGenerals += (cells[sq] == HG + 1);
+            choGenerals += (cells[sq] == CG + 1);
+        }
+        values[b] = Finish(score, hanGenerals, choGenerals);
+    }
+}
+
+#if EVAL_X86
+
+static int CountTrailingZeros(unsigned int v)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, v);
+    return (int)index;
+#else
+    return __builtin_ctz(v);
+#endif
+}
+
+// About a third of the squares are occupied : byte compares find them 16
+// at a time, and only those are looked up.
+static void SSE2Kernel(const uint8_t* cells, int count, int* values)
+{
+    const __m128i empty = _mm_setzero_si128();
+    const __m128i hanGeneral = _mm_set1_epi8(HG + 1);
+    const __m128i choGeneral = _mm_set1_epi8(CG + 1);
+    for (int b = 0; b < count; b++, cells += kPackedCells) {
+        int score = 0, hanGenerals = 0, choGenerals = 0;
+        for (int base = 0; base < kPackedCells; base += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(cells + base));
+            unsigned int occupied = ~(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, empty)) & 0xFFFF;
+            hanGenerals |= _mm_movemask_epi8(_mm_cmpeq_epi8(v, hanGeneral));
+            choGenerals |= _mm_movemask_epi8(_mm_cmpeq_epi8(v, choGeneral));
+            while (occupied) {
+                int sq = base + CountTrailingZeros(occupied);
+                score += gTable[sq][cells[sq]];
+                occupied &= occupied - 1;
+            }
+        }
+        values[b] = Finish(score, hanGenerals, choGenerals);
+    }
+}
+
+EVAL_TARGET_AVX2
+static void AVX2Kernel(const uint8_t* cells, int count, int* values)
+{
+    // index of kTable[square][0] for the 8 squares of a step
+    const __m256i rows = _mm256_setr_epi32(0, kCodes, 2 * kCodes, 3 * kCodes,
+        4 * kCodes, 5 * kCodes, 6 * kCodes, 7 * kCodes);
+    const __m256i hanGeneral = _mm256_set1_epi32(HG + 1);
+    const __m256i choGeneral = _mm256_set1_epi32(CG + 1);
+    const int* table = &gTable[0][0];
+    for (int b = 0; b < count; b++, cells += kPackedCells) {
+        __m256i acc = _mm256_setzero_si256();
+        __m256i hanGenerals = _mm256_setzero_si256();
+        __m256i choGenerals = _mm256_setzero_si256();
+        for (int base = 0; base < kPackedCells; base += 8) {
+            __m256i code = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(cells + base)));
+            __m256i index = _mm256_add_epi32(_mm256_add_epi32(rows, _mm256_set1_epi32(base * kCodes)), code);
+            acc = _mm256_add_epi32(acc, _mm256_i32gather_epi32(table, index, 4));
+            hanGenerals = _mm256_or_si256(hanGenerals, _mm256_cmpeq_epi32(code, hanGeneral));
+            choGenerals = _mm256_or_si256(choGenerals, _mm256_cmpeq_epi32(code, choGeneral));
+        }
+        __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+        values[b] = Finish(_mm_cvtsi128_si32(sum),
+            _mm256_movemask_epi8(hanGenerals), _mm256_movemask_epi8(choGenerals));
+    }
+}
+
+static bool CpuHasAVX2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif /* EVAL_X86 */
+
+typedef void (*KernelFunction)(const uint8_t* cells, int count, int* values);
+
+static KernelFunction gKernel = ScalarKernel;
+static const char* gKernelName = "scalar";
+static bool gReady = InitParams(); // before any search starts a thread
+
+void SetEvalKernel(EvalKernel kernel)
+{
+    gKernel = ScalarKernel;
+    gKernelName = "scalar";
+#if EVAL_X86
+    if (kernel == EVAL_AUTO)
+        kernel = CpuHasAVX2() ? EVAL_AVX2 : EVAL_SSE2;
+    if (kernel == EVAL_SSE2) {
+        gKernel = SSE2Kernel;
+        gKernelName = "sse2";
+    }
+    else if (kernel == EVAL_AVX2 && CpuHasAVX2()) {
+        gKernel = AVX2Kernel;
+        gKernelName = "avx2";
+    }
+#endif
+}
+
+const char* GetEvalKernelName()
+{
+    return gKernelName;
+}
+
+void EvaluateBoards(const Board* const* boards, int count, int* values)
+{
+    uint8_t cells[kEvalChunk * kPackedCells];
+    for (int start = 0; start < count; start += kEvalChunk) {
+        int n = (count - start < kEvalChunk ? count - start : kEvalChunk);
+        for (int i = 0; i < n; i++)
+            Pack(boards[start + i], cells + i * kPackedCells);
+        gKernel(cells, n, values + start);
+    }
+}
@@ -0,0 +1,43 @@
+//
+//  eval.h
+//
+
+#ifndef eval_h
+#define eval_h
+
+#include "defines.h"
+
+class Board;
+
+// Evaluation weights, from the point of view of the owner of the unit.
+// Piece-square values are given for cho (home at the bottom), han reads
+// them upside down. The generals have no material value : a missing
+// general is a decided game.
+struct EvalParams {
+    int material[IDSize / 2];
+    int pieceSquare[IDSize / 2][kStageHeight][kStageWidth];
+};
+
+enum EvalKernel {
+    EVAL_SCALAR,
+    EVAL_SSE2,   // occupancy found with byte compares, lookups for occupied squares only
+    EVAL_AVX2,   // one gather per 8 squares
+    EVAL_AUTO,   // the best kernel the cpu supports
+};
+
+const EvalParams& GetEvalParams();
+void SetEvalParams(const EvalParams& params); // not thread safe, call before searching
+// Text weights : "material" and a value for each kind, then for each kind
+// but the general its letter after "square" and the 10 rows of its
+// piece-square values, top row first.
+bool LoadEvalParams(const string& path); // the weights are unchanged on failure
+bool SaveEvalParams(const string& path, const EvalParams& params);
+
+// Same unit as Board::GetValue : cho's score relative to han's score.
+int EvaluateStage(const int stage[][kStageWidth]);
+void EvaluateBoards(const Board* const* boards, int count, int* values);
+
+void SetEvalKernel(EvalKernel kernel); // falls back to scalar if unsupported
+const char* GetEvalKernelName();
+
+#endif /* eval_h */
@@ -0,0 +1,35 @@
+//
+//  evaluator.cpp
+//
+
+#include <cmath>
+#include "evaluator.h"
+#include "eval.h"
+
+double NormalizeValue(int value)
+{
+  // rewards are squashed into [-1, 1] so that they can be averaged and
+  // weighed against the exploration term.
+  if (value >= (INT_MAX / 2))
+    return 1.0;
+  if (value <= -(INT_MAX / 2))
+    return -1.0;
+  return std::tanh(value / MCTS_VALUE_SCALE);
+}
+
+int DenormalizeValue(double reward)
+{
+  if (reward >= 1.0 - EPSILON)
+    return kWinValue;
+  if (reward <= -1.0 + EPSILON)
+    return -kWinValue;
+  return (int)std::lround(std::atanh(reward) * MCTS_VALUE_SCALE);
+}
+
+void MaterialEvaluator::Evaluate(const Board* const* boards, const Turn* /*turns*/, int count, double* values)
+{
+  scores.resize(count);
+  EvaluateBoards(boards, count, &scores[0]);
+  for (int i = 0; i < count; i++)
+    values[i] = NormalizeValue(scores[i]);
+}
@@ -0,0 +1,35 @@
+//
+//  evaluator.h
+//
+
+#ifndef evaluator_h
+#define evaluator_h
+
+#include <vector>
+#include "defines.h"
+#include "board.h"
+
+// squashes a Board::GetValue() score into a reward in [-1, 1]
+double NormalizeValue(int value);
+// back from a reward to a Board::GetValue() score
+int DenormalizeValue(double reward);
+
+// Scores MCTS leaves. A whole batch of boards is handed over in one call so
+// that an implementation can amortize its per-call cost.
+// values[i] is the reward of boards[i] in [-1, 1], from cho's point of view.
+class Evaluator {
+public:
+    virtual ~Evaluator() {}
+    virtual void Evaluate(const Board* const* boards, const Turn* turns, int count, double* values) = 0;
+};
+
+// material and piece-square balance of eval.h, scored by its SIMD kernels.
+class MaterialEvaluator : public Evaluator {
+public:
+    void Evaluate(const Board* const* boards, const Turn* turns, int count, double* values);
+
+private:
+    std::vector<int> scores;
+};
+
+#endif /* evaluator_h */
@@ -3,279 +3,942 @@
 #include <iostream>
 #include <algorithm>
 #include <cassert>
+#include <cstdlib>
+#include <vector>
+#include <chrono>
+#include <cstring>
 
 #include "janggi.h"
 #include "defines.h"
 #include "board.h"
 #include "action.h"
 #include "node.h"
+#include "trace.h"
+#include "tree_file.h"
+
+Janggi::Janggi() : searchType(SEARCH_MCTS), searchDepth(ALPHA_BETA_DEPTH), evaluator(NULL), mctsPolicy(MCTS_UCT), explorationConstant(MCTS_UCT_C),
+  useTranspositions(false), transpositionProbes(0), transpositionHits(0),
+  memoryBudget(0), memoryPolicy(MEMORY_FREEZE), memoryExhausted(false),
+  iterationBudget(MCTS_ITERATION), timeBudget(0.0), earlyStop(true), lastIterations(0), ply(0),
+  searchNodes(0), nextCheck(0), stopped(false), checkStop(false), stopRequest(false), deadline(0),
+  progressInterval(MCTS_PROGRESS_INTERVAL), multiPV(1),
+  mateNodes(MATE_NODE_LIMIT)
+{
+    memset(history, 0, sizeof(history));
+    memset(pvLength, 0, sizeof(pvLength));
+    ClearOrdering();
+    mateSolver.SetStop(&stopRequest);
+}
+
+bool Janggi::SetBookPath(const string& path)
+{
+    book.Close();
+    return path.empty() || book.Open(path);
+}
+
+void Janggi::NewGame()
+{
+    nodePool.Release(rootNode.children);
+    rootNode = Node();
+    nodeTable.clear();
+    tt.Clear();
+    mateSolver.Clear();
+    memset(history, 0, sizeof(history));
+    ClearOrdering();
+}
 
 const Action Janggi::CalculateNextAction(Turn turn)
 {
-    //mini-max algorithm
-    //Node s = Minmax(curNode, MINMAX_DEPTH, turn); // Minmax returns one of her children.
-    
-    //alpha-beta prunning
-    //Node s = AlphaBeta(curNode, MINMAX_DEPTH, INT_MIN, INT_MAX, turn);
-    
-    //MCTS algorithm
-    Node s = MCTS(turn);
-    
-    return s.GetAction();
+    TRACE_SCOPE("CalculateNextAction");
+    ReportProgress(SearchResult());
+    SearchResult r;
+
+    // known openings are played at once
+    if (book.Probe(rootNode.board, turn, r.action)) {
+        ReportProgress(r);
+        ResetStop();
+        return r.action;
+    }
+
+    // a forced mate needs no other search
+    if (mateNodes > 0 && IsKingAttack(rootNode.board, turn) &&
+        mateSolver.Solve(rootNode.board, turn, mateNodes) == MATE_FOUND) {
+        r.action = mateSolver.GetMateAction();
+        r.score = (turn == TURN_CHO ? kWinValue : -kWinValue);
+        r.nodes = mateSolver.GetNodes();
+        ReportProgress(r);
+        ResetStop();
+        return r.action;
+    }
+
+    switch (searchType) {
+      case SEARCH_MINMAX: {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        stats.Clear();
+        stats.searches = 1;
+        Board board(rootNode.board);
+        r.depth = min(searchDepth, MAX_PLY - 1);
+        r.score = Minmax(board, r.depth, turn);
+        r.action = pvLength[0] > 0 ? pvTable[0][0] : Action();
+        r.pv = GetPV();
+        stats.depth = r.depth;
+        stats.SetBranching(stats.nodes, r.depth);
+        stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        totalStats.Add(stats);
+        r.nodes = stats.nodes;
+        r.seconds = stats.seconds;
+        lines.assign(1, r);
+        ReportProgress(r);
+        ResetStop();
+        return r.action;
+      }
+      case SEARCH_ALPHA_BETA:
+        lastResult = IterativeDeepening(rootNode.board, turn, searchDepth, 0.0);
+        return lastResult.action;
+      case SEARCH_MCTS:
+        return MCTS(turn);
+    }
+    return Action();
+}
+
+void Janggi::SetProgressCallback(ProgressCallback callback, int iterations)
+{
+    progressCallback = callback;
+    progressInterval = max(iterations, 1);
+}
+
+SearchResult Janggi::GetProgress()
+{
+    lock_guard<mutex> guard(progressLock);
+    return progress;
+}
+
+void Janggi::ReportProgress(const SearchResult& result)
+{
+    if (result.rank == 1) {
+        lock_guard<mutex> guard(progressLock);
+        progress = result;
+    }
+    if (progressCallback && !result.action.IsNull())
+        progressCallback(result);
+}
+
+// the mate solver is worth its time when several points of the enemy
+// palace are already under attack.
+bool Janggi::IsKingAttack(Board& board, Turn turn)
+{
+    Pos general = board.FindGeneral(turn == TURN_CHO ? TURN_HAN : TURN_CHO);
+    if (general.x < 0)
+        return false;
+    int top = (general.y <= 2 ? 0 : 7);
+    int attacked = 0;
+    for (int y = top; y < top + 3; y++) {
+        for (int x = 3; x <= 5; x++) {
+            if (board.IsAttacked(Pos(x, y), turn))
+                attacked++;
+        }
+    }
+    return attacked >= MATE_PALACE_ATTACKS;
 }
 
 void Janggi::Print() {
   rootNode.Print();
 }
 
-Node Janggi::Minmax(Node node, int depth, Turn turn) {
-    if (depth==0 || //terminal node
-#if WIN32        
-      abs(node.GetValue()) >= (INT_MAX / 2) // win or lose
-      ) {
-#else
-      fabs(node.GetValue()) >= (INT_MAX / 2) // win or lose
-      ) {
-#endif
-        node.SetLeafValue(node.GetValue());
-        return node; //only one child. herself.
-    }
-    
-    vector<Node> children = node.GetChildren(turn);
-    
-    int best_value;
-    Node best_node;
-    if (turn == TURN_CHO) { //maximizing player
-        best_value = INT_MIN;
-        for (Node n : children) {
-            int v = Minmax(n, depth-1, TURN_HAN).GetLeafValue();
-            if(v > best_value) {
-                best_value = v;
-                n.SetLeafValue(v);
-                best_node = n;
-            }
-        }
-    } else { //TRUN_HAN . minizing player
-        best_value = INT_MAX;
-        for (Node n : children) {
-            int v = Minmax(n, depth-1, TURN_CHO).GetLeafValue();
-            if (v < best_value) {
-                best_value = v;
-                n.SetLeafValue(v);
-                best_node = n;
-            }
+// Tries every action down to depth.
+int Janggi::Minmax(Board& board, int depth, Turn turn) {
+    stats.nodes++;
+    pvLength[ply] = ply;
+    int value = board.GetValue();
+    if (depth == 0 || abs(value) >= (INT_MAX / 2)) // terminal node, win or lose
+        return value;
+
+    ActionList actions;
+    board.GetPossibleActions(turn, GEN_ALL, actions);
+    CheckInfo info;
+    board.GetCheckInfo(turn, info);
+    Turn next = (turn == TURN_CHO) ? TURN_HAN : TURN_CHO;
+    int best_value = (turn == TURN_CHO) ? INT_MIN : INT_MAX; // cho maximizes, han minimizes
+    int searched = 0;
+    for (int i = 0; i < actions.size; i++) {
+        Action a = actions[i];
+        if (!board.IsLegalAction(a, turn, info))
+            continue;
+        searched++;
+        int captured = board.DoAction(a);
+        ply++;
+        int v = Minmax(board, depth - 1, next);
+        ply--;
+        board.UndoAction(a, captured);
+        if (turn == TURN_CHO ? v > best_value : v < best_value) {
+            best_value = v;
+            UpdatePV(a);
         }
     }
-    
-    //debug
-    /*
-    if ( depth == MINMAX_DEPTH) {
-        int i=0;
-        for (Node n: children) {
-            Board b= n.board;
-            printf("%d) %d,%d -> %d,%d\n", i++, n.GetAction().prev.x, n.GetAction().prev.y, n.GetAction().next.x, n.GetAction().next.y);
+    if (searched == 0) // checkmate, or no action at all
+        return board.GetNoActionValue(turn);
+    return best_value;
+}
+
+int Janggi::AlphaBeta(Board& board, uint64_t hash, int depth, int alpha, int beta, Turn turn) {
+    pvLength[ply] = ply;
+    if (depth == 0)
+        return Quiescence(board, alpha, beta, turn); // counts the node
+    searchNodes++;
+    int value = board.GetValue();
+    if (value <= -INT_MAX / 2 || value >= INT_MAX / 2) // win or lose
+        return value;
+    stats.maxPly = max(stats.maxPly, ply);
+    if (ply > 0 && IsStopped())
+        return 0;
+    int tbValue;
+    if (ply > 0 && tablebases.Probe(board, turn, tbValue)) // small endgame, known result
+        return tbValue;
+
+    // a stored result deep enough answers the node, except at the root
+    // which has to return an action.
+    Action ttMove;
+    TTEntry entry;
+    stats.ttProbes++;
+    if (tt.Probe(hash, entry)) {
+        stats.ttHits++;
+        ttMove = Action::Unpack(entry.move);
+        if (!ttMove.IsOnStage()) // a shared table is written by other processes
+            ttMove = Action();
+        if (ply > 0 && entry.depth >= depth &&
+            (entry.bound == BOUND_EXACT ||
+             (entry.bound == BOUND_LOWER && entry.score >= beta) ||
+             (entry.bound == BOUND_UPPER && entry.score <= alpha)))
+            return entry.score;
+    }
+
+    int alphaOrig = alpha, betaOrig = beta;
+    int best_value = (turn == TURN_CHO) ? INT_MIN : INT_MAX;
+    Action bestAction;
+    Turn next = (turn == TURN_CHO) ? TURN_HAN : TURN_CHO;
+    MovePicker picker(&board, turn, ttMove, killers[ply], history[turn]);
+    int searched = 0;
+    Action a;
+    while (!(a = picker.Next()).IsNull()) {
+        if (ply == 0 && IsExcluded(a))
+            continue;
+        uint64_t childHash = board.UpdateHash(hash, a);
+        int captured = board.DoAction(a);
+        ply++;
+        int v = AlphaBeta(board, childHash, depth-1, alpha, beta, next);
+        ply--;
+        board.UndoAction(a, captured);
+        if (stopped)
+            break;
+        searched++;
+
+        if (turn == TURN_CHO ? v > best_value : v < best_value) {
+            best_value = v;
+            bestAction = a;
+            UpdatePV(a);
         }
-        printf("best : %d,%d -> %d,%d. best_score = %d\n",
-               best_node.GetAction().prev.x,
-               best_node.GetAction().prev.y,
-               best_node.GetAction().next.x,
-               best_node.GetAction().next.y,
-               best_value);
-    }
-    */
-    return best_node;
-}
-
-Node Janggi::AlphaBeta(Node node, int depth, int alpha, int beta, Turn turn) {
-    if (depth==0 || //terminal node
-#if WIN32
-      abs(node.GetValue()) >= (INT_MAX / 2) // win or lose
-      ) {
-#else
-        fabs(node.GetValue()) >= (INT_MAX/2) // win or lose
-        ) {
-#endif
-        node.SetLeafValue(node.GetValue());
-        return node; //only one child. herself.
-    }
-    
-    vector<Node> children = node.GetChildren(turn);
-    
-    int best_value;
-    Node best_node;
-    if (turn == TURN_CHO) { //maximizing player
-        best_value = INT_MIN;
-        best_node.SetLeafValue(best_value);
-        for (Node n : children) {
-            int v = AlphaBeta(n, depth-1, alpha, beta, TURN_HAN).GetLeafValue();
-            if ( beta <= alpha ) break; // beta cut-off
-            
+        if (turn == TURN_CHO) //maximizing player
             alpha = max(alpha, v);
-            if(v > best_value) {
-                best_value = v;
-                n.SetLeafValue(v);
-                best_node = n;
-            }
+        else //TRUN_HAN . minizing player
+            beta = min(beta, v);
+        if (beta <= alpha) { // cut-off
+            stats.cutoffs++;
+            if (searched == 1)
+                stats.firstCutoffs++;
+            if (captured < 0)
+                UpdateOrdering(a, depth, turn);
+            break;
+        }
+    }
+    if (stopped)
+        return best_value;
+    if (searched == 0) // checkmate, or no action at all
+        return board.GetNoActionValue(turn);
+    stats.interiorNodes++;
+
+    Bound bound = BOUND_EXACT;
+    if (best_value <= alphaOrig)
+        bound = BOUND_UPPER;
+    else if (best_value >= betaOrig)
+        bound = BOUND_LOWER;
+    // when every action failed low the best of them means nothing. a root
+    // searched without some of its actions is not worth a store.
+    bool failLow = (turn == TURN_CHO) ? bound == BOUND_UPPER : bound == BOUND_LOWER;
+    if (ply > 0 || excluded.empty())
+        tt.Store(hash, best_value, depth, bound, failLow ? Action() : bestAction);
+    return best_value;
+}
+
+// a is the best action at ply : the line from ply is a, then the best line
+// of the child.
+void Janggi::UpdatePV(Action a)
+{
+    pvTable[ply][ply] = a;
+    int length = (ply + 1 < MAX_PLY) ? pvLength[ply + 1] : ply + 1;
+    for (int i = ply + 1; i < length; i++)
+        pvTable[ply][i] = pvTable[ply + 1][i];
+    pvLength[ply] = max(length, ply + 1);
+}
+
+bool Janggi::IsExcluded(Action a)
+{
+    for (int i = 0; i < excluded.size; i++) {
+        if (excluded[i] == a)
+            return true;
+    }
+    return false;
+}
+
+vector<Action> Janggi::GetPV()
+{
+    return vector<Action>(pvTable[0], pvTable[0] + pvLength[0]);
+}
+
+// Searches deeper and deeper until maxDepth, a decided value or the time
+// limit. The first depth is always completed, so that there is an action
+// to play, and a depth cut by the time limit is thrown away.
+SearchResult Janggi::IterativeDeepening(Board& board, Turn turn, int maxDepth, double seconds)
+{
+    SearchResult result;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (seconds > 0)
+        SetDeadline(seconds);
+    ReportProgress(result);
+    stats.Clear();
+    stats.searches = 1;
+    searchNodes = 0;
+    nextCheck = 0;
+    stopped = false;
+    maxDepth = min(maxDepth, MAX_PLY - 1);
+    uint64_t hash = board.GetHash(turn);
+    lines.clear();
+    for (int depth = 1; depth <= maxDepth; depth++) {
+        checkStop = depth > 1;
+        TRACE_SCOPE_ARG("AlphaBeta", depth);
+        ClearOrdering();
+        // each line is the best without the root actions of the lines
+        // before it. they share the transposition table.
+        vector<SearchResult> found;
+        excluded.clear();
+        for (int k = 0; k < multiPV && !stopped; k++) {
+            int v = AlphaBeta(board, hash, depth, INT_MIN, INT_MAX, turn);
+            if (stopped || (k > 0 && pvLength[0] == 0))
+                break;
+            SearchResult line;
+            line.action = pvLength[0] > 0 ? pvTable[0][0] : Action();
+            line.score = v;
+            line.depth = depth;
+            line.pv = GetPV();
+            line.rank = k + 1;
+            line.nodes = searchNodes;
+            line.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            found.push_back(line);
+            if (line.action.IsNull())
+                break;
+            excluded.push_back(line.action);
         }
-    } else { //TRUN_HAN . minizing player
-        best_value = INT_MAX;
-        best_node.SetLeafValue(best_value);
-        for (Node n : children) {
-            int v = AlphaBeta(n, depth-1, alpha, beta, TURN_CHO).GetLeafValue();
-            if ( beta <= alpha ) break; // alpha cut-off
+        excluded.clear();
+        if (stopped)
+            break;
+        lines = found;
+        result = found[0];
+        for (SearchResult& line : found)
+            ReportProgress(line);
+        if (result.action.IsNull() || result.score <= -INT_MAX / 2 || result.score >= INT_MAX / 2)
+            break;
+        if (stopRequest || IsPastDeadline())
+            break;
+    }
+    checkStop = false;
+    stopped = false;
+    ResetStop();
+    result.nodes = searchNodes;
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    stats.nodes = searchNodes;
+    stats.depth = result.depth;
+    stats.SetBranching(stats.nodes - stats.quiescenceNodes, result.depth);
+    stats.seconds = result.seconds;
+    totalStats.Add(stats);
+    return result;
+}
+
+// the clock is read once every 1024 nodes.
+bool Janggi::IsStopped()
+{
+    if (!stopped && checkStop && searchNodes >= nextCheck) {
+        nextCheck = searchNodes + 1024;
+        stopped = stopRequest || IsPastDeadline();
+    }
+    return stopped;
+}
+
+bool Janggi::IsPastDeadline()
+{
+    long long d = deadline;
+    return d != 0 && chrono::steady_clock::now().time_since_epoch().count() >= d;
+}
+
+void Janggi::SetDeadline(double seconds)
+{
+    chrono::steady_clock::duration wait = chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(seconds));
+    deadline = (long long)(chrono::steady_clock::now() + wait).time_since_epoch().count();
+}
+
+void Janggi::ResetStop()
+{
+    stopRequest = false;
+    deadline = 0;
+}
+
+// Searches the captures which do not lose material until the position is
+// quiet, so that a leaf is not valued in the middle of an exchange.
+int Janggi::Quiescence(Board& board, int alpha, int beta, Turn turn)
+{
+    searchNodes++;
+    stats.maxPly = max(stats.maxPly, ply);
+    int best_value = board.GetValue();
+    if (best_value <= -INT_MAX / 2 || best_value >= INT_MAX / 2 || ply >= MAX_PLY)
+        return best_value;
+    // the side to move may decline every capture
+    if (turn == TURN_CHO) {
+        if (best_value >= beta)
+            return best_value;
+        alpha = max(alpha, best_value);
+    }
+    else {
+        if (best_value <= alpha)
+            return best_value;
+        beta = min(beta, best_value);
+    }
 
+    Turn next = (turn == TURN_CHO) ? TURN_HAN : TURN_CHO;
+    MovePicker picker(&board, turn);
+    Action a;
+    while (!(a = picker.Next()).IsNull()) {
+        int captured = board.DoAction(a);
+        ply++;
+        stats.quiescenceNodes++; // beyond the alpha-beta leaves
+        int v = Quiescence(board, alpha, beta, next);
+        ply--;
+        board.UndoAction(a, captured);
+        if (turn == TURN_CHO) {
+            best_value = max(best_value, v);
+            alpha = max(alpha, v);
+        }
+        else {
+            best_value = min(best_value, v);
             beta = min(beta, v);
-            if (v < best_value) {
-                best_value = v;
-                n.SetLeafValue(v);
-                best_node = n;
-            }
         }
+        if (beta <= alpha)
+            break;
     }
-    
-    //debug
-    
-     if ( depth == MINMAX_DEPTH) {
-     int i=0;
-     for (Node n: children) {
-     Board b= n.board;
-     printf("%d) %d,%d -> %d,%d\n", i++, n.GetAction().prev.x, n.GetAction().prev.y, n.GetAction().next.x, n.GetAction().next.y);
-     }
-     printf("best : %d,%d -> %d,%d. best_score = %d\n",
-     best_node.GetAction().prev.x,
-     best_node.GetAction().prev.y,
-     best_node.GetAction().next.x,
-     best_node.GetAction().next.y,
-     best_value);
-     }
-    
-    return best_node;
-}
-
-Node Janggi::MCTS(Turn turn)
+    return best_value;
+}
+
+void Janggi::ClearOrdering()
 {
-  rootNode.Init();
+    for (int i = 0; i < MAX_PLY; i++) {
+        for (int k = 0; k < MovePicker::kKillers; k++)
+            killers[i][k] = Action();
+    }
+    // older searches still tell something, with less weight
+    for (int t = 0; t < 2; t++) {
+        for (int f = 0; f < kStageSquares; f++) {
+            for (int s = 0; s < kStageSquares; s++)
+                history[t][f][s] /= 2;
+        }
+    }
+}
+
+// a quiet action cut off : try it early at this ply and in similar positions.
+void Janggi::UpdateOrdering(Action a, int depth, Turn turn)
+{
+    if (ply < MAX_PLY && !(killers[ply][0] == a)) {
+        killers[ply][1] = killers[ply][0];
+        killers[ply][0] = a;
+    }
+    int& h = history[turn][a.prev.y * kStageWidth + a.prev.x][a.next.y * kStageWidth + a.next.x];
+    h += depth * depth;
+}
+
+// a selected leaf waiting for the evaluator.
+struct PendingLeaf {
+  vector<Node*> visited;      // from the root to the leaf
+  vector<double> virtualLoss; // score charged to each visited node
+  Node* leaf;
+  Turn turn;                  // player to move at the leaf
+  bool evaluated;             // terminal leaves are scored on selection
+  double value;
+};
+
+Action Janggi::MCTS(Turn turn)
+{
+  // the tree left by PerformAction is searched further when it is the
+  // tree of this position and turn.
+  uint64_t hash = rootNode.board.GetHash(turn);
+  if (rootNode.isLeaf || rootNode.hash != hash || useTranspositions) {
+    nodePool.Release(rootNode.children);
+    rootNode.Init();
+    rootNode.hash = hash;
+  }
+  SetMemoryBudget(memoryBudget, memoryPolicy); // the table cost depends on the mode
+  nodeTable.clear();
+  transpositionProbes = transpositionHits = 0;
+  if (useTranspositions)
+    nodeTable[rootNode.hash] = &rootNode;
+#if DEBUG_MCTS
   cout << endl << endl;
-  for (int i = 0; i < MCTS_ITERATION; i++) {
-    Turn currTurn = turn;
-    std::stack<Node*> visited;
-    Node* pCur = &rootNode;
-
-    std::stack<double> rewards;
-
-    int selected = 0;
-    double curReward = 0.0f;
-
-    // Selection
-    Node* first = NULL;
-    while (!pCur->isLeaf) {
-      selected = pCur->Selection(currTurn);
-      pCur = pCur->GetChild(selected);
-      if (first == NULL) {
-        first = pCur;
+#endif
+
+  Evaluator* eval = GetEvaluator();
+  vector<PendingLeaf> batch;
+  vector<const Board*> boards;
+  vector<Turn> turns;
+  vector<double> values;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  rootHistory.clear();
+  stats.Clear();
+  stats.searches = 1;
+  int iteration = 0;
+  int nextReport = progressInterval;
+  while (iteration < iterationBudget) {
+    batch.clear();
+    for (int b = 0; b < MCTS_BATCH_SIZE && iteration < iterationBudget; b++, iteration++) {
+      batch.push_back(PendingLeaf());
+      PendingLeaf& pending = batch.back();
+      Turn currTurn = turn;
+      Node* pCur = &rootNode;
+      pCur->AddVirtualLoss(0.0);
+      pending.visited.push_back(pCur);
+      pending.virtualLoss.push_back(0.0);
+
+      // moves one step down and charges the virtual loss to the player
+      // who chose the child.
+      // In transposition mode the path follows the shared nodes, and a
+      // position already on the path is a repetition : it is not entered.
+      auto descend = [&]() -> bool {
+        int selected = pCur->Selection(currTurn, mctsPolicy, explorationConstant);
+        Node* next = pCur->GetChild(selected)->Target();
+        if (useTranspositions &&
+          std::find(pending.visited.begin(), pending.visited.end(), next) != pending.visited.end())
+          return false;
+        pCur = next;
+        double loss = (currTurn == TURN_CHO ? -MCTS_VIRTUAL_LOSS : MCTS_VIRTUAL_LOSS);
+        pCur->AddVirtualLoss(loss);
+        pending.visited.push_back(pCur);
+        pending.virtualLoss.push_back(loss);
+        currTurn = (currTurn == TURN_CHO ? TURN_HAN : TURN_CHO);
+        return true;
+      };
+
+      // Selection
+      bool repetition = false;
+      {
+        TRACE_SCOPE("MCTS selection");
+        while (!pCur->isLeaf && !pCur->children.empty() && !repetition)
+          repetition = !descend();
       }
-      visited.push(pCur);
-      curReward = pCur->GetValue();      
-      //curReward = pCur->GetScore();
-      rewards.push(curReward);
-      currTurn = (currTurn == TURN_CHO ? TURN_HAN : TURN_CHO);
-    }
 #if DEBUG_MCTS
-    if (first) {
-      cout << "init : (" << first->GetAction().prev.x << "," <<
-        first->GetAction().prev.y << ") => (" <<
-        first->GetAction().next.x << "," <<
-        first->GetAction().next.y << ")" << endl;
-    }
+      if (pending.visited.size() > 1) {
+        Node* first = pending.visited[1];
+        cout << "init : (" << first->GetAction().prev.x << "," <<
+          first->GetAction().prev.y << ") => (" <<
+          first->GetAction().next.x << "," <<
+          first->GetAction().next.y << ")" << endl;
+      }
 #endif
-    // Expand
-    pCur->Expand(currTurn);
-    selected = pCur->Selection(currTurn);
-    pCur = pCur->GetChild(selected);
-    
-    // Simulation
-    double value = Simulation(*pCur, currTurn == TURN_CHO ? TURN_HAN : TURN_CHO);
-    pCur->totalScore = value;
+      // Expand
+      pending.evaluated = true;
+      int tbValue;
+      bool known = !repetition && pCur != &rootNode && tablebases.Probe(pCur->board, currTurn, tbValue);
+      if (!repetition && !known && abs(pCur->GetValue()) < (INT_MAX / 2)) { // win or lose. nothing to expand.
+        if (!pCur->Expand(currTurn, &nodePool, pCur == &rootNode)) {
+          memoryExhausted = true;
+          pending.evaluated = false; // the leaf itself is evaluated
+        }
+        else if (useTranspositions) {
+          RegisterChildren(pCur);
+        }
+        if (!pCur->children.empty()) {
+          repetition = !descend();
+          pending.evaluated = repetition;
+        }
+      }
+      pending.leaf = pCur;
+      pending.turn = currTurn;
+      stats.treeDepth = max(stats.treeDepth, (int)pending.visited.size() - 1);
+      if (pending.evaluated) {
+        if (repetition)
+          pending.value = 0.0; // a repetition is scored as a draw
+        else if (known)
+          pending.value = NormalizeValue(tbValue);
+        else if (!pCur->isLeaf && pCur->children.empty())
+          pending.value = NormalizeValue(pCur->board.GetNoActionValue(currTurn));
+        else
+          pending.value = NormalizeValue(pCur->GetValue());
+      }
+    }
+
+    // Evaluation of the whole batch at once
+    boards.clear();
+    turns.clear();
+    for (PendingLeaf& pending : batch) {
+      if (!pending.evaluated) {
+        boards.push_back(&pending.leaf->board);
+        turns.push_back(pending.turn);
+      }
+    }
+    values.resize(boards.size());
+    if (!boards.empty()) {
+      TRACE_SCOPE("MCTS evaluation");
+      eval->Evaluate(&boards[0], &turns[0], (int)boards.size(), &values[0]);
+    }
 
     // Back Propagation
-    while (!visited.empty())
     {
-      pCur = visited.top();
-      if (currTurn == TURN_CHO)
-        pCur->totalScore = min(rewards.top(), value);
-      else
-        pCur->totalScore = max(rewards.top(), value);
+      TRACE_SCOPE("MCTS backpropagation");
+      int k = 0;
+      for (PendingLeaf& pending : batch) {
+        double value = pending.evaluated ? pending.value : values[k++];
+        for (size_t j = 0; j < pending.visited.size(); j++) {
+          pending.visited[j]->RevertVirtualLoss(pending.virtualLoss[j]);
+          pending.visited[j]->Update(value);
+        }
+      }
+    }
+
+    if (memoryExhausted && memoryPolicy == MEMORY_RECYCLE)
+      RecycleNodes();
+    memoryExhausted = false;
 
-      visited.pop();
-      rewards.pop();
-      currTurn = (currTurn == TURN_CHO ? TURN_HAN : TURN_CHO);
+    // Budget and early termination
+    int remaining = iterationBudget - iteration;
+    if (timeBudget > 0) {
+      double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      if (elapsed >= timeBudget)
+        break;
+      // iterations that still fit in the time left, at the current speed
+      double expected = iteration / elapsed * (timeBudget - elapsed);
+      if (expected < remaining)
+        remaining = (int)expected;
+    }
+    if (earlyStop && iteration >= MCTS_MIN_ITERATION && IsDecided(remaining))
+      break;
+    if (stopRequest || IsPastDeadline())
+      break;
+    if (iteration >= nextReport) {
+      ReportProgress(GetMCTSResult(iteration, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()));
+      nextReport += progressInterval;
     }
   }
-  int bestNode = 0;
-  double bestValue;
-  if (turn == TURN_CHO) {
-    bestValue = -std::numeric_limits<double>::max();
-    for (int i = 0; i < rootNode.children.size(); i++) {
-      double value = rootNode.children[i].GetScore();
-      if (value > bestValue) {
-        bestValue = value;
-        bestNode = i;
-      }
 
+  lastIterations = iteration;
+  stats.playouts = iteration;
+  stats.treeNodes = (long long)nodePool.GetLiveNodes();
+  stats.ttProbes = transpositionProbes;
+  stats.ttHits = transpositionHits;
+  stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  totalStats.Add(stats);
+  SetMCTSLines(iteration, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  for (SearchResult& line : lines)
+    ReportProgress(line);
+  ResetStop();
+
+  // the most visited child is the most robust choice.
+  int bestNode = 0;
+  for (int i = 0; i < (int)rootNode.children.size(); i++) {
+    if (rootNode.children[i].Target()->visitCount > rootNode.children[bestNode].Target()->visitCount)
+      bestNode = i;
 #if DEBUG_MCTS
-      double deb_score = rootNode.children[i].GetScore();
-      if (deb_score > 0 && deb_score < 0.001)
-        deb_score = 0.001;
-      else if (deb_score < 0 && deb_score > -0.001)
-        deb_score = -0.001;
-      else if (deb_score == 0)
-        deb_score = 0;
-
-
-      std::cout << "(" << rootNode.children[i].GetAction().prev.x << ", "
-        << rootNode.children[i].GetAction().prev.y << ") => ("
-        << rootNode.children[i].GetAction().next.x << ", "
-        << rootNode.children[i].GetAction().next.y << ") : "
-        << deb_score << endl;
+    std::cout << "(" << rootNode.children[i].GetAction().prev.x << ", "
+      << rootNode.children[i].GetAction().prev.y << ") => ("
+      << rootNode.children[i].GetAction().next.x << ", "
+      << rootNode.children[i].GetAction().next.y << ") : "
+      << rootNode.children[i].Target()->visitCount << " visits, "
+      << rootNode.children[i].Target()->GetScore() << endl;
 #endif
-    }
   }
-  else {
-    bestValue = std::numeric_limits<double>::max();
-    for (int i = 0; i < rootNode.children.size(); i++) {
-      double value = rootNode.children[i].GetScore();
-      if (value < bestValue) {
-        bestValue = value;
-        bestNode = i;
-      }
 #if DEBUG_MCTS
-      double deb_score = rootNode.children[i].GetScore();
-      if (deb_score > 0 && deb_score < 0.001)
-        deb_score = 0.001;
-      else if (deb_score < 0 && deb_score > -0.001)
-        deb_score = -0.001;
-      else if (deb_score == 0)
-        deb_score = 0;
-
-
-      std::cout << "(" << rootNode.children[i].GetAction().prev.x << ", "
-        << rootNode.children[i].GetAction().prev.y << ") => ("
-        << rootNode.children[i].GetAction().next.x << ", "
-        << rootNode.children[i].GetAction().next.y << ") : "
-        << deb_score << endl;
+  if (useTranspositions)
+    cout << "transposition hit rate : " << GetTranspositionHitRate() << endl;
 #endif
+  if (rootNode.children.empty())
+    return Action(); // no possible action
+  return rootNode.children[bestNode].GetAction();
+}
+
+// the most visited child of the root, and its value as a score.
+SearchResult Janggi::GetMCTSResult(int iterations, double seconds)
+{
+  SearchResult r;
+  int visits = -1;
+  for (Node& child : rootNode.children) {
+    if (child.Target()->visitCount > visits) {
+      visits = child.Target()->visitCount;
+      r.action = child.GetAction();
+      r.score = DenormalizeValue(child.Target()->GetScore());
+    }
+  }
+  r.iterations = iterations;
+  r.seconds = seconds;
+  return r;
+}
+
+// The multiPV most visited children of the root, each followed by the
+// most visited child down the tree.
+void Janggi::SetMCTSLines(int iterations, double seconds)
+{
+  vector<Node*> ranked;
+  for (Node& child : rootNode.children)
+    ranked.push_back(&child);
+  std::stable_sort(ranked.begin(), ranked.end(), [](Node* a, Node* b) {
+    return a->Target()->visitCount > b->Target()->visitCount;
+  });
+  lines.clear();
+  for (int k = 0; k < multiPV && k < (int)ranked.size(); k++) {
+    SearchResult line;
+    line.action = ranked[k]->GetAction();
+    line.score = DenormalizeValue(ranked[k]->Target()->GetScore());
+    line.iterations = iterations;
+    line.seconds = seconds;
+    line.rank = k + 1;
+    Node* n = ranked[k];
+    while (n != NULL && (int)line.pv.size() < MAX_PLY) {
+      line.pv.push_back(n->GetAction());
+      Node* next = NULL;
+      for (Node& c : n->Target()->children) {
+        if (c.Target()->visitCount > 0 && (next == NULL || c.Target()->visitCount > next->Target()->visitCount))
+          next = &c;
+      }
+      n = next;
+    }
+    lines.push_back(line);
+  }
+  if (lines.empty()) {
+    SearchResult none;
+    none.iterations = iterations;
+    none.seconds = seconds;
+    lines.push_back(none);
+  }
+}
+
+// Links every child whose position is already in the table to the node
+// holding its statistics, registers the others.
+void Janggi::RegisterChildren(Node* n)
+{
+  for (Node& child : n->children) {
+    transpositionProbes++;
+    unordered_map<uint64_t, Node*>::iterator it = nodeTable.find(child.hash);
+    if (it != nodeTable.end()) {
+      child.link = it->second;
+      transpositionHits++;
+    }
+    else {
+      nodeTable[child.hash] = &child;
+    }
+  }
+}
+
+double Janggi::GetTranspositionHitRate()
+{
+  if (transpositionProbes == 0)
+    return 0.0;
+  return (double)transpositionHits / transpositionProbes;
+}
+
+// bytes per entry of nodeTable, bucket and allocation overhead included.
+static const size_t kNodeTableEntryBytes = 48;
+
+void Janggi::SetMemoryBudget(size_t bytes, MemoryPolicy policy)
+{
+  memoryBudget = bytes;
+  memoryPolicy = policy;
+  // every tree node may also cost a table entry
+  size_t perNode = sizeof(Node) + (useTranspositions ? kNodeTableEntryBytes : 0);
+  nodePool.SetBudget(bytes == 0 ? 0 : std::max<size_t>(bytes / perNode, 1));
+}
+
+size_t Janggi::GetTreeMemory()
+{
+  return sizeof(Node) * nodePool.GetAllocatedNodes() + kNodeTableEntryBytes * nodeTable.size();
+}
+
+// Collapses the least visited subtrees until MCTS_RECYCLE_FRACTION of the
+// nodes in use went back to the pool. Called between batches only, when no
+// path holds pointers into the tree.
+void Janggi::RecycleNodes()
+{
+  // expanded nodes but the root. deeper first on ties, so that a subtree is
+  // released before its ancestor.
+  vector<pair<pair<int, int>, Node*> > candidates;
+  vector<pair<Node*, int> > stack;
+  stack.push_back(make_pair(&rootNode, 0));
+  while (!stack.empty()) {
+    Node* n = stack.back().first;
+    int depth = stack.back().second;
+    stack.pop_back();
+    if (n != &rootNode)
+      candidates.push_back(make_pair(make_pair(n->visitCount, -depth), n));
+    for (Node& child : n->children) {
+      if (!child.isLeaf)
+        stack.push_back(make_pair(&child, depth + 1));
+    }
+  }
+  std::sort(candidates.begin(), candidates.end());
+
+  size_t goal = (size_t)(nodePool.GetLiveNodes() * MCTS_RECYCLE_FRACTION);
+  size_t freed = 0;
+  unordered_set<Node*> released;
+  for (size_t i = 0; i < candidates.size() && freed < goal; i++) {
+    Node* n = candidates[i].second;
+    if (released.count(n))
+      continue;
+    freed += nodePool.Release(n->children, &released);
+    n->isLeaf = true;
+  }
+
+  if (!useTranspositions)
+    return;
+  // forget the released positions, and turn the links to them back into
+  // plain leaves.
+  for (unordered_map<uint64_t, Node*>::iterator it = nodeTable.begin(); it != nodeTable.end(); ) {
+    if (released.count(it->second))
+      it = nodeTable.erase(it);
+    else
+      ++it;
+  }
+  stack.push_back(make_pair(&rootNode, 0));
+  while (!stack.empty()) {
+    Node* n = stack.back().first;
+    stack.pop_back();
+    for (Node& child : n->children) {
+      if (child.link && released.count(child.link)) {
+        child.link = NULL;
+        if (nodeTable.find(child.hash) == nodeTable.end())
+          nodeTable[child.hash] = &child;
+      }
+      if (!child.isLeaf)
+        stack.push_back(make_pair(&child, 0));
+    }
+  }
+}
+
+// True when the remaining iterations cannot change the decision : the most
+// visited child leads by more than remaining visits, or the root value and
+// the best child have been stable for MCTS_CONVERGENCE_WINDOW batches.
+bool Janggi::IsDecided(int remaining)
+{
+  int best = -1;
+  int bestVisits = 0, secondVisits = 0;
+  for (int i = 0; i < (int)rootNode.children.size(); i++) {
+    int visits = rootNode.children[i].Target()->visitCount;
+    if (best < 0 || visits > bestVisits) {
+      secondVisits = bestVisits;
+      bestVisits = visits;
+      best = i;
+    }
+    else if (visits > secondVisits) {
+      secondVisits = visits;
     }
   }
-  return rootNode.children[bestNode];
+  if (best < 0)
+    return true;
+  if (bestVisits - secondVisits > remaining)
+    return true;
+
+  rootHistory.push_back(make_pair(rootNode.GetScore(), best));
+  if ((int)rootHistory.size() <= MCTS_CONVERGENCE_WINDOW)
+    return false;
+  const pair<double, int>& old = rootHistory[rootHistory.size() - 1 - MCTS_CONVERGENCE_WINDOW];
+  for (size_t i = rootHistory.size() - MCTS_CONVERGENCE_WINDOW; i < rootHistory.size(); i++) {
+    if (rootHistory[i].second != best ||
+        fabs(rootHistory[i].first - old.first) > MCTS_CONVERGENCE_EPSILON)
+      return false;
+  }
+  return true;
+}
+
+void Janggi::SetMCTSBudget(int iterations, double seconds)
+{
+  iterationBudget = iterations;
+  timeBudget = seconds;
 }
 
-double Janggi::Simulation(Node curNode, Turn turn)
+void Janggi::SetMCTSPolicy(MCTSPolicy policy, double c)
 {
-  Node s = Minmax(curNode, MCTS_SIMULATION_DEPTH, turn);
-  curNode.Init();
-  return s.GetValue();
+  mctsPolicy = policy;
+  explorationConstant = c;
 }
 
 void Janggi::PerformAction(Action a) {
+  // the subtree of the action played becomes the tree. a link is only a
+  // view of another node, and its subtree is not kept.
+  for (Node& child : rootNode.children) {
+    if (child.GetAction() == a && child.link == NULL && !child.isLeaf) {
+      // the arrays are swapped out so that only the fields of child are
+      // copied. child lives in siblings until they are released.
+      vector<Node> grandchildren, siblings;
+      grandchildren.swap(child.children);
+      siblings.swap(rootNode.children);
+      rootNode = child;
+      rootNode.children.swap(grandchildren);
+      nodePool.Release(siblings);
+      return;
+    }
+  }
+  nodePool.Release(rootNode.children);
+  rootNode.Init();
   rootNode.DoAction(a);
+}
+
+void Janggi::SetPosition(const Board& board)
+{
+  nodePool.Release(rootNode.children);
+  rootNode = Node(board); // a new node has no children to copy
+}
+
+bool Janggi::SaveTree(const string& path, Turn turn)
+{
+  return WriteTree(path, rootNode, turn);
+}
+
+// the next MCTS of the position goes on with the tree, unless it
+// searches transpositions, whose table is built again.
+bool Janggi::LoadTree(const string& path, Board& board, Turn& turn)
+{
+  if (!ReadTree(path, rootNode, turn, nodePool))
+    return false;
+  nodeTable.clear();
+  board = rootNode.board;
+  return true;
+}
+
+// the reply the last search expects after a : the most visited answer in
+// the MCTS tree, or the action stored in the transposition table.
+Action Janggi::GetExpectedReply(Action a, Turn turn)
+{
+  Turn next = (turn == TURN_CHO ? TURN_HAN : TURN_CHO);
+  Board board(rootNode.board);
+  uint64_t hash = board.UpdateHash(board.GetHash(turn), a);
+  board.DoAction(a);
+  Action reply;
+  for (Node& child : rootNode.children) {
+    if (child.GetAction() == a) {
+      Node* n = child.Target();
+      int visits = 0;
+      for (Node& c : n->children) {
+        if (c.Target()->visitCount > visits) {
+          visits = c.Target()->visitCount;
+          reply = c.GetAction();
+        }
+      }
+    }
+  }
+  TTEntry entry;
+  if (reply.IsNull() && tt.Probe(hash, entry))
+    reply = Action::Unpack(entry.move);
+  if (reply.IsNull() || !reply.IsOnStage() || !board.IsPossibleAction(reply, next))
+    return Action();
+  return reply;
 }
\ No newline at end of file
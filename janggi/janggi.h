@@ -1,24 +1,150 @@
 #ifndef JANGGI_H
 #define JANGGI_H
 
+#include <unordered_map>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <functional>
 #include "defines.h"
 #include "board.h"
 #include "node.h"
+#include "evaluator.h"
+#include "tt.h"
+#include "move_picker.h"
+#include "mate.h"
+#include "tablebase.h"
+#include "book.h"
+#include "stats.h"
 
 #define DEBUG_MCTS 0
 
+// What an iterative deepening search found.
+struct SearchResult {
+    Action action;    // null when there is no legal action
+    int score;        // cho's point of view
+    int depth;        // last completed depth
+    long long nodes;  // alpha-beta and quiescence nodes
+    int iterations;   // MCTS
+    double seconds;
+    vector<Action> pv; // the line expected from action on
+    int rank;          // 1 : the best line, 2 : the best without the first action, ...
+
+    SearchResult() : score(0), depth(0), nodes(0), iterations(0), seconds(0.0), rank(1) {};
+};
+
+// called by the searching thread with the best so far.
+typedef function<void(const SearchResult&)> ProgressCallback;
+
 class Janggi{ // almost utility class.
 public:
+    Janggi();
+    void NewGame(); // back to the initial position, tables cleared
     const Action CalculateNextAction(Turn turn);
-    Node Minmax(Node n, int depth, Turn turn);
-    Node AlphaBeta(Node node, int depth, int alpha, int beta, Turn turn);    
-    Node MCTS(Turn turn);
-    double Simulation(Node n, Turn turn);
+    // board is changed during the search and restored. the best line is
+    // left in the principal variation table, see GetPV().
+    int Minmax(Board& board, int depth, Turn turn);
+    int AlphaBeta(Board& board, uint64_t hash, int depth, int alpha, int beta, Turn turn);
+    SearchResult IterativeDeepening(Board& board, Turn turn, int maxDepth, double seconds); // seconds <= 0 : no time limit
+    int Quiescence(Board& board, int alpha, int beta, Turn turn);
+    Action MCTS(Turn turn); // of the most visited child, the tree is kept
     void Print();
-    void PerformAction(Action a);
+    void PerformAction(Action a); // keeps the MCTS subtree of the position reached
+    void SetPosition(const Board& board);
+    bool SaveTree(const string& path, Turn turn); // the MCTS tree of the position, turn to move
+    bool LoadTree(const string& path, Board& board, Turn& turn); // the position becomes the one of the tree
+    Action GetExpectedReply(Action a, Turn turn); // null when unknown
+    void Stop() { stopRequest = true; }; // from any thread, ends the running search
+    void SetDeadline(double seconds);    // from any thread, ends the running search after seconds
+    void ResetStop();                    // forgets Stop() and SetDeadline() which came after the last search
+    SearchResult GetLastResult() { return lastResult; }; // of the last alpha-beta of CalculateNextAction
+    void SetProgressCallback(ProgressCallback callback, int iterations = MCTS_PROGRESS_INTERVAL); // after each depth, or every iterations of MCTS
+    SearchResult GetProgress(); // from any thread, best so far of the running or last search
+    vector<Action> GetPV(); // of the last minmax or alpha-beta
+    void SetMultiPV(int lines) { multiPV = min(max(lines, 1), MAX_MULTI_PV); }; // alpha-beta and MCTS
+    vector<SearchResult> GetLines() { return lines; }; // best first, of the last alpha-beta or MCTS
+    SearchStats GetStats() { return stats; };           // of the last search
+    SearchStats GetTotalStats() { return totalStats; }; // of every search since ResetStats()
+    void ResetStats() { totalStats.Clear(); };
+    void SetSearch(SearchType type, int depth) { searchType = type; searchDepth = depth; }; // depth : minmax and alpha-beta
+    void SetMCTSPolicy(MCTSPolicy policy, double c);
+    void SetEvaluator(Evaluator* e) { evaluator = e; }; // not owned. NULL restores the default.
+    void SetTranspositions(bool on) { useTranspositions = on; }; // share MCTS nodes of transposed positions
+    double GetTranspositionHitRate();
+    void SetMemoryBudget(size_t bytes, MemoryPolicy policy); // 0 : unlimited
+    size_t GetTreeMemory(); // bytes held by the MCTS tree
+    void SetMCTSBudget(int iterations, double seconds); // seconds <= 0 : no time limit
+    void SetEarlyStop(bool on) { earlyStop = on; };
+    int GetLastIterations() { return lastIterations; }; // iterations run by the last MCTS
+    void SetHashSize(size_t mb) { tt.Resize(mb); };
+    bool SetSharedHash(const string& name, size_t mb = TT_SIZE_MB) { return tt.OpenShared(name, mb); }; // with other processes
+    void SetMateSearch(long long nodes) { mateNodes = nodes; }; // 0 : off
+    MateSolver& GetMateSolver() { return mateSolver; };
+    void SetTablebasePath(const string& dir) { tablebases.SetPath(dir); }; // "" : no tablebases, the default
+    bool SetBookPath(const string& path); // "" : no book, the default
     
 private:
+    Evaluator* GetEvaluator() { return evaluator ? evaluator : &defaultEvaluator; };
+    void RegisterChildren(Node* n);
+    void RecycleNodes();
+    bool IsDecided(int remaining);
+    bool IsKingAttack(Board& board, Turn turn);
+    void ClearOrdering();
+    void UpdateOrdering(Action a, int depth, Turn turn);
+    void UpdatePV(Action a);
+    bool IsExcluded(Action a);
+    bool IsStopped();
+    bool IsPastDeadline();
+    void ReportProgress(const SearchResult& result);
+    SearchResult GetMCTSResult(int iterations, double seconds);
+    void SetMCTSLines(int iterations, double seconds);
+
     Node rootNode;
+    SearchType searchType;
+    int searchDepth;
+    Evaluator* evaluator;
+    MaterialEvaluator defaultEvaluator;
+    MCTSPolicy mctsPolicy;
+    double explorationConstant;
+    bool useTranspositions;
+    unordered_map<uint64_t, Node*> nodeTable; // position hash -> node holding its statistics
+    long long transpositionProbes;
+    long long transpositionHits;
+    NodePool nodePool;
+    size_t memoryBudget;
+    MemoryPolicy memoryPolicy;
+    bool memoryExhausted; // an expansion was refused during the last batch
+    int iterationBudget;
+    double timeBudget;
+    bool earlyStop;
+    int lastIterations;
+    vector<pair<double, int> > rootHistory; // root value and best child, one per batch
+    TranspositionTable tt;
+    int ply; // distance from the root of the running alpha-beta
+    long long searchNodes;
+    long long nextCheck; // searchNodes when the clock is read again
+    bool stopped;     // the running alpha-beta is out of time, its values mean nothing
+    bool checkStop;   // the running depth may be stopped
+    atomic<bool> stopRequest;
+    atomic<long long> deadline; // steady clock ticks, 0 : none
+    SearchResult lastResult;
+    mutex progressLock;
+    SearchResult progress;
+    ProgressCallback progressCallback;
+    int progressInterval;
+    SearchStats stats;
+    SearchStats totalStats;
+    Action killers[MAX_PLY][MovePicker::kKillers]; // quiet actions that cut off at a ply
+    int history[2][kStageSquares][kStageSquares];  // [turn][from][to] cut-off score of quiet actions
+    Action pvTable[MAX_PLY][MAX_PLY]; // [ply] : best line found from ply, at pvTable[ply][ply..pvLength[ply])
+    int pvLength[MAX_PLY];
+    int multiPV;
+    vector<SearchResult> lines;
+    ActionList excluded; // root actions of the lines already found
+    MateSolver mateSolver;
+    long long mateNodes;
+    TablebaseSet tablebases;
+    OpeningBook book;
 };
 
 #endif /* JANGGI_H */
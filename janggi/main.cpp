@@ -2,11 +2,23 @@
 #include <string>
 #include <cstdio>
 #include <ctime>
+#include <cstdlib>
+#include <thread>
+#include <fstream>
+#include <atomic>
+#include <new>
+#include <random>
 
 using namespace std;   
 
 #include "defines.h"
 #include "janggi.h"
+#include "tournament.h"
+#include "record.h"
+#include "analysis.h"
+#include "protocol.h"
+#include "trace.h"
+#include "tune.h"
 
 #define ASCIIBASE 48
 
@@ -14,12 +26,71 @@ bool string2ints(string in, Pos& current, Pos& next);
 void autoMode(Janggi& janggi);
 void man2Computer(Janggi& janggi);
 void manualMode(Janggi& janggi);
+int generateTablebase(string material, int threads);
+int buildBook(int argc, char* argv[]);
+int runTournament(int argc, char* argv[]);
+int importRecords(string text, string path);
+int exportRecords(string path);
+int analyzePositions(int argc, char* argv[]);
+int runProtocol(int argc, char* argv[]);
+int runBench(int depth);
+int tuneEval(int argc, char* argv[]);
 
-int main()
+// janggi                            : computer against computer, with BOOK_PATH, TB_PATH
+//                                     and EVAL_PARAMS_PATH
+// janggi tbgen <material> [threads] : writes the tablebases of material to TB_PATH
+// janggi bookgen <records>          : writes BOOK_PATH from game records, binary or one game a line
+// janggi booksearch <plies> <depth> : writes BOOK_PATH from alpha-beta searches
+// janggi tournament <engine> <engine> [games] [threads] [opening plies]
+//        [records]                  : engine is minmax:<depth>, alphabeta:<depth> or mcts:<iterations>,
+//                                     games are appended to records
+// janggi import <text> <records>    : writes the games of text, one a line, as binary records
+// janggi export <records>           : prints binary records, one game a line
+// janggi analyze [file] [threads] [depth:<depth>|time:<seconds>] [multipv:<lines>] [shared:<name>]
+//        [tb:<dir>] [eval:<file>]
+//                                   : best action of each position of file, one FEN a line,
+//                                     or of the standard input when file is missing or "-",
+//                                     or the best lines each with its own first action.
+//                                     shared : the hash table is the shared memory segment name,
+//                                     tb : the tablebases of dir are probed,
+//                                     eval : the weights of file, as written by tune
+// janggi protocol [engine]          : engine commands on the standard input, see protocol.h
+// janggi bench [depth]              : alpha-beta speed on fixed positions, and heap allocations
+//                                     when built with JANGGI_COUNT_ALLOCATIONS
+// janggi tune <records> [threads] [epochs]
+//                                   : fits the evaluation weights, starting from EVAL_PARAMS_PATH
+//                                     when present, to the results of the games and writes them
+//                                     to EVAL_PARAMS_PATH
+int main(int argc, char* argv[])
 {
+#if JANGGI_TRACE
+  atexit([]() { Tracer::WriteChromeTrace(TRACE_PATH); });
+#endif
+  if (argc >= 3 && string(argv[1]) == "tbgen")
+    return generateTablebase(argv[2], argc >= 4 ? atoi(argv[3]) : (int)thread::hardware_concurrency());
+  if (argc >= 3 && (string(argv[1]) == "bookgen" || string(argv[1]) == "booksearch"))
+    return buildBook(argc, argv);
+  if (argc >= 4 && string(argv[1]) == "tournament")
+    return runTournament(argc, argv);
+  if (argc >= 4 && string(argv[1]) == "import")
+    return importRecords(argv[2], argv[3]);
+  if (argc >= 3 && string(argv[1]) == "export")
+    return exportRecords(argv[2]);
+  if (argc >= 2 && string(argv[1]) == "analyze")
+    return analyzePositions(argc, argv);
+  if (argc >= 2 && string(argv[1]) == "protocol")
+    return runProtocol(argc, argv);
+  if (argc >= 2 && string(argv[1]) == "bench")
+    return runBench(argc >= 3 ? atoi(argv[2]) : ALPHA_BETA_DEPTH);
+  if (argc >= 3 && string(argv[1]) == "tune")
+    return tuneEval(argc, argv);
+
   srand(time(NULL));
 
   Janggi janggi;
+  janggi.SetBookPath(BOOK_PATH);
+  janggi.SetTablebasePath(TB_PATH);
+  LoadEvalParams(EVAL_PARAMS_PATH);
   janggi.Print();
 
   autoMode(janggi);
@@ -39,6 +110,10 @@ void autoMode(Janggi& janggi)
         clock_t start = clock();
         Action action = janggi.CalculateNextAction(turn);
         double duration = (clock() - start )/(double)CLOCKS_PER_SEC;
+        if (action.prev.x < 0) {
+            cout << "no possible action" << endl;
+            break;
+        }
         cout << "max depth : " << MINMAX_DEPTH << endl;
         cout << "calc time : " << duration << endl;
         janggi.PerformAction(action); //throws on error. use 'try-catch' to handle exception.
@@ -81,6 +156,10 @@ void man2Computer(Janggi& janggi)
     clock_t start = clock();
     Action action = janggi.CalculateNextAction(turn);
     double duration = (clock() - start) / (double)CLOCKS_PER_SEC;
+    if (action.prev.x < 0) {
+      cout << "no possible action" << endl;
+      break;
+    }
     cout << "max depth : " << MINMAX_DEPTH << endl;
     cout << "calc time : " << duration << endl;
     janggi.PerformAction(action); //throws on error. use 'try-catch' to handle exception.
@@ -107,6 +186,231 @@ void manualMode(Janggi& janggi)
     } while (1);
 }
 
+int generateTablebase(string material, int threads)
+{
+  TablebaseSet set;
+  set.SetPath(TB_PATH);
+  if (set.Generate(material, threads > 0 ? threads : 1) == NULL) {
+    cout << "not a material : " << material << endl;
+    return 1;
+  }
+  return 0;
+}
+
+int buildBook(int argc, char* argv[])
+{
+  BookBuilder builder;
+  if (string(argv[1]) == "bookgen") {
+    int games = builder.AddRecords(argv[2], BOOK_PLIES);
+    cout << games << " games" << endl;
+  }
+  else {
+    if (argc < 4)
+      return 1;
+    Janggi janggi;
+    builder.AddSearch(janggi, Board(), TURN_CHO, atoi(argv[2]), atoi(argv[3]));
+  }
+  cout << builder.GetSize() << " book moves" << endl;
+  if (!builder.Write(BOOK_PATH)) {
+    cout << "can not write " << BOOK_PATH << endl;
+    return 1;
+  }
+  return 0;
+}
+
+int runTournament(int argc, char* argv[])
+{
+  EngineConfig first, second;
+  if (!first.Parse(argv[2]) || !second.Parse(argv[3])) {
+    cout << "engines are minmax:<depth>, alphabeta:<depth> or mcts:<iterations>" << endl;
+    return 1;
+  }
+  int games = argc >= 5 ? atoi(argv[4]) : 100;
+  int threads = argc >= 6 ? atoi(argv[5]) : (int)thread::hardware_concurrency();
+  Tournament tournament(first, second);
+  if (argc >= 7)
+    tournament.SetOpeningPlies(atoi(argv[6]));
+  if (argc >= 8 && !tournament.SetRecordPath(argv[7])) {
+    cout << "can not write " << argv[7] << endl;
+    return 1;
+  }
+  TournamentResult result = tournament.Run(games, threads > 0 ? threads : 1);
+  result.Print(first.name, second.name);
+  return 0;
+}
+
+int importRecords(string text, string path)
+{
+  ifstream in(text.c_str());
+  GameRecordWriter writer;
+  if (!in || !writer.Open(path)) {
+    cout << "can not open " << (in ? path : text) << endl;
+    return 1;
+  }
+  string line;
+  GameRecord game;
+  int lineNumber = 0;
+  while (getline(in, line)) {
+    lineNumber++;
+    if (line.empty() || line[0] == '#')
+      continue;
+    if (!game.FromText(line)) {
+      cout << "line " << lineNumber << " : not a game" << endl;
+      continue;
+    }
+    writer.Write(game);
+  }
+  cout << writer.GetGames() << " games" << endl;
+  return writer.Close() ? 0 : 1;
+}
+
+int exportRecords(string path)
+{
+  GameRecordReader reader;
+  if (!reader.Open(path)) {
+    cout << "not a record file : " << path << endl;
+    return 1;
+  }
+  GameView view;
+  GameRecord game;
+  while (reader.Next(view)) {
+    view.ToRecord(game);
+    cout << game.ToText() << "\n";
+  }
+  cout.flush();
+  return reader.IsDamaged() ? 1 : 0;
+}
+
+int analyzePositions(int argc, char* argv[])
+{
+  int threads = argc >= 4 ? atoi(argv[3]) : (int)thread::hardware_concurrency();
+  int depth = ALPHA_BETA_DEPTH;
+  double seconds = 0.0;
+  int multiPV = 1;
+  string sharedHash, tablebasePath;
+  for (int i = 4; i < argc; i++) {
+    string limit = argv[i];
+    if (limit.compare(0, 6, "depth:") == 0) {
+      depth = atoi(limit.c_str() + 6);
+    }
+    else if (limit.compare(0, 5, "time:") == 0) {
+      depth = MAX_PLY / 2;
+      seconds = atof(limit.c_str() + 5);
+      if (seconds <= 0)
+        depth = 0;
+    }
+    else if (limit.compare(0, 8, "multipv:") == 0) {
+      multiPV = atoi(limit.c_str() + 8);
+      if (multiPV <= 0)
+        depth = 0;
+    }
+    else if (limit.compare(0, 7, "shared:") == 0) {
+      sharedHash = limit.substr(7);
+    }
+    else if (limit.compare(0, 3, "tb:") == 0) {
+      tablebasePath = limit.substr(3);
+    }
+    else if (limit.compare(0, 5, "eval:") == 0) {
+      if (!LoadEvalParams(limit.substr(5))) {
+        cout << "can not read " << limit.substr(5) << endl;
+        return 1;
+      }
+    }
+    else {
+      depth = 0;
+    }
+    if (depth <= 0) {
+      cout << "limits are depth:<depth> or time:<seconds>, options multipv:<lines>, shared:<name>, tb:<dir> and eval:<file>" << endl;
+      return 1;
+    }
+  }
+  Analyzer analyzer(threads, depth, seconds);
+  analyzer.SetMultiPV(multiPV);
+  analyzer.SetSharedHash(sharedHash);
+  analyzer.SetTablebasePath(tablebasePath);
+  if (argc < 3 || string(argv[2]) == "-") {
+    analyzer.Run(cin, cout);
+    return 0;
+  }
+  ifstream in(argv[2]);
+  if (!in) {
+    cout << "can not open " << argv[2] << endl;
+    return 1;
+  }
+  analyzer.Run(in, cout);
+  return 0;
+}
+
+int runProtocol(int argc, char* argv[])
+{
+  EngineConfig config;
+  if (argc >= 3 && !config.Parse(argv[2])) {
+    cout << "engines are minmax:<depth>, alphabeta:<depth> or mcts:<iterations>" << endl;
+    return 1;
+  }
+  Protocol protocol(config);
+  protocol.Run(cin, cout);
+  return 0;
+}
+
+#if JANGGI_COUNT_ALLOCATIONS
+// every heap allocation of the program, for bench
+static atomic<long long> allocations(0);
+
+void* operator new(size_t size)
+{
+  allocations++;
+  void* p = malloc(size ? size : 1);
+  if (p == NULL)
+    throw bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
+#else
+static const long long allocations = 0;
+#endif
+
+int runBench(int depth)
+{
+  // positions after 0, 6, ... 66 random plies from the start, always the same
+  mt19937 rng(7);
+  long long nodes = 0, allocated = 0;
+  double seconds = 0.0;
+  for (int i = 0; i < 12; i++) {
+    Board board;
+    Turn turn = TURN_CHO;
+    for (int ply = 0; ply < i * 6; ply++) {
+      vector<Action> legal = board.GetLegalActions(turn);
+      if (legal.empty())
+        break;
+      board.DoAction(legal[rng() % legal.size()]);
+      turn = (turn == TURN_CHO ? TURN_HAN : TURN_CHO);
+    }
+    Janggi janggi;
+    long long before = allocations;
+    SearchResult r = janggi.IterativeDeepening(board, turn, depth, 0.0);
+    allocated += allocations - before;
+    nodes += r.nodes;
+    seconds += r.seconds;
+    printf("%2d : %d%d%d%d score %d nodes %lld\n", i + 1,
+      r.action.prev.x, r.action.prev.y, r.action.next.x, r.action.next.y, r.score, r.nodes);
+  }
+  printf("nodes %lld, %.3fs, %.0f nodes/s", nodes, seconds, seconds > 0 ? nodes / seconds : 0.0);
+  if (JANGGI_COUNT_ALLOCATIONS)
+    printf(", %lld allocations (%.6f per node)", allocated, nodes ? (double)allocated / nodes : 0.0);
+  printf("\n");
+  return 0;
+}
+
 bool string2ints(string in, Pos& current, Pos& next)
 {
   if (in.size() != 4)
@@ -118,4 +422,31 @@ bool string2ints(string in, Pos& current, Pos& next)
   next.y = in[3] - ASCIIBASE;
 
   return true;
-}
\ No newline at end of file
+}
+
+int tuneEval(int argc, char* argv[])
+{
+  int threads = argc >= 4 ? atoi(argv[3]) : (int)thread::hardware_concurrency();
+  int epochs = argc >= 5 ? atoi(argv[4]) : TUNE_EPOCHS;
+  LoadEvalParams(EVAL_PARAMS_PATH); // a run goes on from the weights of the last one
+  Tuner tuner(threads);
+  if (tuner.AddRecords(argv[2]) < 0) {
+    cout << "not a record file : " << argv[2] << endl;
+    return 1;
+  }
+  if (tuner.GetSize() == 0) {
+    cout << "no positions" << endl;
+    return 1;
+  }
+  cout << tuner.GetSize() << " positions" << endl;
+  cout << "scale " << tuner.FitScale() << " error " << tuner.GetError() << endl;
+  double error = tuner.Run(epochs, TUNE_RATE, cout);
+  EvalParams params;
+  tuner.GetParams(params);
+  cout << "error " << error << endl;
+  if (!SaveEvalParams(EVAL_PARAMS_PATH, params)) {
+    cout << "can not write " << EVAL_PARAMS_PATH << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,39 @@
+//
+//  mapped_file.h
+//
+
+#ifndef mapped_file_h
+#define mapped_file_h
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+// Read-only view of a whole file through mmap (MapViewOfFile on windows).
+// Pages are loaded by the system on first access and shared by every
+// process mapping the same file.
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+    bool Open(const string& path);
+    void Close();
+    bool IsOpen() { return data != NULL; };
+    const uint8_t* GetData() { return data; };
+    size_t GetSize() { return size; };
+
+private:
+    MappedFile(const MappedFile&);            // not copyable
+    MappedFile& operator=(const MappedFile&);
+
+    const uint8_t* data;
+    size_t size;
+#ifdef _WIN32
+    void* file;
+    void* mapping;
+#endif
+};
+
+#endif /* mapped_file_h */
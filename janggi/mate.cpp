@@ -0,0 +1,201 @@
+//
+//  mate.cpp
+//
+
+#include <cstring>
+#include <algorithm>
+#include "mate.h"
+
+static const uint32_t kInfinity = 1u << 30;
+
+static uint32_t AddNumbers(uint32_t a, uint32_t b)
+{
+    return min(kInfinity, a + b);
+}
+
+MateSolver::MateSolver(size_t mb) : mask(0), attacker(TURN_CHO), nodes(0), nodeLimit(0), stop(NULL)
+{
+    Resize(mb);
+}
+
+// the number of entries is the largest power of two that fits in mb.
+void MateSolver::Resize(size_t mb)
+{
+    size_t count = 2;
+    size_t bytes = (mb > 0 ? mb : 1) << 20;
+    while (count * 2 * sizeof(Entry) <= bytes)
+        count *= 2;
+    entries.assign(count, Entry());
+    mask = count - 1;
+    Clear();
+}
+
+void MateSolver::Clear()
+{
+    memset(&entries[0], 0, entries.size() * sizeof(Entry));
+}
+
+MateResult MateSolver::Solve(Board board, Turn turn, long long limit)
+{
+    attacker = turn;
+    root = board;
+    mateAction = Action();
+    nodes = 0;
+    nodeLimit = limit;
+    path.clear();
+
+    uint64_t hash = board.GetHash(turn);
+    MID(board, hash, turn, kInfinity, kInfinity, 0);
+
+    uint32_t phi, delta;
+    Lookup(hash, phi, delta);
+    if (phi == 0) {
+        mateAction = GetBest(hash);
+        return MATE_FOUND;
+    }
+    return delta == 0 ? MATE_NONE : MATE_UNKNOWN;
+}
+
+vector<Action> MateSolver::GetMateLine()
+{
+    vector<Action> line;
+    if (mateAction.IsNull())
+        return line;
+    Board board = root;
+    Turn turn = attacker;
+    uint64_t hash = board.GetHash(turn);
+    for (int ply = 0; ply < MAX_PLY; ply++) {
+        Action a = GetBest(hash);
+        if (a.IsNull() || !board.IsPossibleAction(a, turn))
+            break;
+        line.push_back(a);
+        hash = board.UpdateHash(hash, a);
+        board.DoAction(a);
+        turn = (turn == TURN_CHO ? TURN_HAN : TURN_CHO);
+    }
+    return line;
+}
+
+// The numbers of a node are those of the player to move : phi is the least
+// delta of the children, delta the sum of their phi. The child with the
+// least delta is searched until it makes this node exceed a threshold.
+void MateSolver::MID(Board& board, uint64_t hash, Turn turn, uint32_t thPhi, uint32_t thDelta, int ply)
+{
+    nodes++;
+    bool attackerToMove = (turn == attacker);
+    ActionList actions;
+    GenerateActions(board, turn, actions);
+    if (actions.empty()) { // mated, or out of checks : the player to move lost
+        Store(hash, kInfinity, 0, 1, Action());
+        return;
+    }
+    if (ply >= MAX_PLY) { // too deep, counts as a failure of the attacker
+        if (attackerToMove)
+            Store(hash, kInfinity, 0, 1, Action());
+        else
+            Store(hash, 0, kInfinity, 1, Action());
+        return;
+    }
+
+    Turn next = (turn == TURN_CHO ? TURN_HAN : TURN_CHO);
+    uint64_t childHash[ActionList::kCapacity];
+    for (int i = 0; i < actions.size; i++)
+        childHash[i] = board.UpdateHash(hash, actions[i]);
+    path.push_back(hash);
+    long long start = nodes;
+
+    while (true) {
+        uint32_t phi = kInfinity, delta = 0, delta2 = kInfinity, bestPhi = kInfinity;
+        int best = 0;
+        for (int i = 0; i < actions.size; i++) {
+            uint32_t cPhi, cDelta;
+            if (find(path.begin(), path.end(), childHash[i]) != path.end()) {
+                cPhi = attackerToMove ? 0 : kInfinity; // a repetition, the attacker failed
+                cDelta = attackerToMove ? kInfinity : 0;
+            }
+            else {
+                Lookup(childHash[i], cPhi, cDelta);
+            }
+            delta = AddNumbers(delta, cPhi);
+            if (cDelta < phi) {
+                delta2 = phi;
+                phi = cDelta;
+                bestPhi = cPhi;
+                best = i;
+            }
+            else if (cDelta < delta2) {
+                delta2 = cDelta;
+            }
+        }
+        if (phi >= thPhi || delta >= thDelta || nodes >= nodeLimit || (stop && *stop)) {
+            Store(hash, phi, delta, (uint32_t)min<long long>(nodes - start, kInfinity), actions[best]);
+            break;
+        }
+        uint32_t childThPhi = thDelta + bestPhi - delta;
+        uint32_t childThDelta = min(thPhi, delta2 == kInfinity ? kInfinity : delta2 + 1);
+        Board b(board);
+        b.DoAction(actions[best]);
+        MID(b, childHash[best], next, childThPhi, childThDelta, ply + 1);
+    }
+    path.pop_back();
+}
+
+// the attacker only tries the actions which give check
+void MateSolver::GenerateActions(Board& board, Turn turn, ActionList& actions)
+{
+    ActionList all;
+    board.GetPossibleActions(turn, GEN_ALL, all);
+    CheckInfo info;
+    board.GetCheckInfo(turn, info);
+    Turn defender = (attacker == TURN_CHO ? TURN_HAN : TURN_CHO);
+    for (int i = 0; i < all.size; i++) {
+        if (!board.IsLegalAction(all[i], turn, info))
+            continue;
+        if (turn == attacker) {
+            Board b(board);
+            b.DoAction(all[i]);
+            if (!b.IsInCheck(defender))
+                continue;
+        }
+        actions.push_back(all[i]);
+    }
+}
+
+// an unknown position starts at 1 / 1
+void MateSolver::Lookup(uint64_t hash, uint32_t& phi, uint32_t& delta)
+{
+    size_t slot = hash & mask & ~(size_t)1;
+    for (size_t i = slot; i < slot + 2; i++) {
+        if (entries[i].key == hash && entries[i].work > 0) {
+            phi = entries[i].phi;
+            delta = entries[i].delta;
+            return;
+        }
+    }
+    phi = delta = 1;
+}
+
+// two entries per bucket. the position just searched is always stored, in
+// place of its older entry or else of the entry backed by less work.
+void MateSolver::Store(uint64_t hash, uint32_t phi, uint32_t delta, uint32_t work, Action best)
+{
+    size_t slot = hash & mask & ~(size_t)1;
+    Entry* e = &entries[slot];
+    if (entries[slot + 1].key == hash || (e->key != hash && entries[slot + 1].work < e->work))
+        e = &entries[slot + 1];
+    e->key = hash;
+    e->phi = phi;
+    e->delta = delta;
+    e->work = max(work, 1u);
+    e->best = best.Pack();
+}
+
+Action MateSolver::GetBest(uint64_t hash)
+{
+    size_t slot = hash & mask & ~(size_t)1;
+    for (size_t i = slot; i < slot + 2; i++) {
+        if (entries[i].key == hash && entries[i].work > 0)
+            return Action::Unpack(entries[i].best);
+    }
+    return Action();
+}
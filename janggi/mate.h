@@ -0,0 +1,64 @@
+//
+//  mate.h
+//
+
+#ifndef mate_h
+#define mate_h
+
+#include <vector>
+#include <cstdint>
+#include <atomic>
+#include "defines.h"
+#include "board.h"
+
+enum MateResult {
+    MATE_UNKNOWN,    // the node limit was reached first
+    MATE_FOUND,      // the attacker mates by checks whatever the defence
+    MATE_NONE,       // no mate by checks
+};
+
+// Depth-first proof-number search (df-pn) of a mate by consecutive checks.
+// The attacker only tries checking actions, the defender tries all of its
+// legal actions, so the tree stays narrow and mates far beyond the reach
+// of AlphaBeta are found. Proof and disproof numbers are kept in a table of
+// its own, of fixed size, in which the entries backed by less work are
+// overwritten first. A position repeated on the path counts as a failure
+// of the attacker.
+class MateSolver {
+public:
+    MateSolver(size_t mb = MATE_TT_SIZE_MB);
+    void Resize(size_t mb);
+    void Clear();
+    MateResult Solve(Board board, Turn attacker, long long nodeLimit = MATE_NODE_LIMIT);
+    Action GetMateAction() { return mateAction; }; // first action of the mate, after MATE_FOUND
+    vector<Action> GetMateLine(); // one line of the proof, after MATE_FOUND
+    long long GetNodes() { return nodes; };
+    void SetStop(const atomic<bool>* flag) { stop = flag; }; // a set flag ends the search as if out of nodes
+
+private:
+    struct Entry {
+        uint64_t key;
+        uint32_t phi;   // proof number for the player to move
+        uint32_t delta; // disproof number for the player to move
+        uint32_t work;  // nodes searched below, for replacement
+        unsigned short best;
+    };
+
+    void MID(Board& board, uint64_t hash, Turn turn, uint32_t thPhi, uint32_t thDelta, int ply);
+    void GenerateActions(Board& board, Turn turn, ActionList& actions);
+    void Lookup(uint64_t hash, uint32_t& phi, uint32_t& delta);
+    void Store(uint64_t hash, uint32_t phi, uint32_t delta, uint32_t work, Action best);
+    Action GetBest(uint64_t hash);
+
+    vector<Entry> entries;
+    size_t mask;
+    Turn attacker;
+    Board root;
+    Action mateAction;
+    long long nodes;
+    long long nodeLimit;
+    const atomic<bool>* stop;
+    vector<uint64_t> path; // hashes from the root, for repetitions
+};
+
+#endif /* mate_h */
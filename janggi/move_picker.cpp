@@ -0,0 +1,134 @@
+//
+//  move_picker.cpp
+//
+
+#include "move_picker.h"
+
+MovePicker::MovePicker(Board* b, Turn t, Action tt, const Action* k, const int (*h)[kStageSquares])
+  : board(b), turn(t), stage(PICK_TT), ttMove(tt), killers(k), history(h), killerIndex(0),
+    capturesOnly(false), current(0)
+{
+    board->GetCheckInfo(turn, info);
+    if (ttMove.IsNull() || !board->IsPossibleAction(ttMove, turn))
+        stage = PICK_INIT_CAPTURES;
+}
+
+MovePicker::MovePicker(Board* b, Turn t)
+  : board(b), turn(t), stage(PICK_INIT_CAPTURES), killers(NULL), history(NULL), killerIndex(0),
+    capturesOnly(true), current(0)
+{
+    board->GetCheckInfo(turn, info);
+}
+
+Action MovePicker::Next()
+{
+    Action a;
+    switch (stage) {
+        case PICK_TT:
+            stage = PICK_INIT_CAPTURES;
+            if (board->IsLegalAction(ttMove, turn, info))
+                return ttMove;
+            // fall through
+        case PICK_INIT_CAPTURES:
+            list.clear();
+            board->GetPossibleActions(turn, GEN_CAPTURES, list);
+            for (int i = 0; i < list.size; i++) {
+                Action& c = list[i];
+                list.scores[i] = Board::GetUnitValue(board->stage[c.next.y][c.next.x]) * 16
+                               - Board::GetUnitValue(board->stage[c.prev.y][c.prev.x]) / 8;
+            }
+            current = 0;
+            stage = PICK_CAPTURES;
+            // fall through
+        case PICK_CAPTURES:
+            while (!(a = PickBest()).IsNull()) {
+                if (a == ttMove || !board->IsLegalAction(a, turn, info))
+                    continue;
+                if (IsLosingCapture(a)) {
+                    if (!capturesOnly)
+                        badCaptures.push_back(a);
+                    continue;
+                }
+                return a;
+            }
+            if (capturesOnly) {
+                stage = PICK_END;
+                break;
+            }
+            stage = PICK_KILLERS;
+            // fall through
+        case PICK_KILLERS:
+            while (killers && killerIndex < kKillers) {
+                a = killers[killerIndex++];
+                if (a.IsNull() || a == ttMove || (killerIndex == 2 && a == killers[0]))
+                    continue;
+                if (IsQuiet(a) && board->IsPossibleAction(a, turn) && board->IsLegalAction(a, turn, info))
+                    return a;
+            }
+            stage = PICK_INIT_QUIETS;
+            // fall through
+        case PICK_INIT_QUIETS:
+            list.clear();
+            board->GetPossibleActions(turn, GEN_QUIETS, list);
+            for (int i = 0; i < list.size; i++) {
+                Action& q = list[i];
+                list.scores[i] = history ? history[q.prev.y * kStageWidth + q.prev.x][q.next.y * kStageWidth + q.next.x] : 0;
+            }
+            current = 0;
+            stage = PICK_QUIETS;
+            // fall through
+        case PICK_QUIETS:
+            while (!(a = PickBest()).IsNull()) {
+                if (!IsSearched(a) && board->IsLegalAction(a, turn, info))
+                    return a;
+            }
+            current = 0;
+            stage = PICK_BAD_CAPTURES;
+            // fall through
+        case PICK_BAD_CAPTURES:
+            if (current < badCaptures.size)
+                return badCaptures[current++];
+            stage = PICK_END;
+            // fall through
+        case PICK_END:
+            break;
+    }
+    return Action();
+}
+
+// one step of a selection sort : most nodes cut off long before the list
+// would be fully sorted.
+Action MovePicker::PickBest()
+{
+    if (current >= list.size)
+        return Action();
+    int best = current;
+    for (int i = current + 1; i < list.size; i++) {
+        if (list.scores[i] > list.scores[best])
+            best = i;
+    }
+    swap(list.actions[best], list.actions[current]);
+    swap(list.scores[best], list.scores[current]);
+    return list.actions[current++];
+}
+
+// a unit taking a unit worth as much never loses, the rest needs an exchange
+bool MovePicker::IsLosingCapture(Action a)
+{
+    int victim = Board::GetUnitValue(board->stage[a.next.y][a.next.x]);
+    if (victim >= Board::GetUnitValue(board->stage[a.prev.y][a.prev.x]))
+        return false;
+    return board->See(a) < 0;
+}
+
+// returned by an earlier stage
+bool MovePicker::IsSearched(Action a)
+{
+    if (a == ttMove)
+        return true;
+    for (int i = 0; killers && i < killerIndex; i++) {
+        if (a == killers[i])
+            return true;
+    }
+    return false;
+}
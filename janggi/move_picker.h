@@ -0,0 +1,61 @@
+//
+//  move_picker.h
+//
+
+#ifndef move_picker_h
+#define move_picker_h
+
+#include "defines.h"
+#include "action.h"
+#include "board.h"
+
+enum PickStage {
+    PICK_TT,
+    PICK_INIT_CAPTURES,
+    PICK_CAPTURES,
+    PICK_KILLERS,
+    PICK_INIT_QUIETS,
+    PICK_QUIETS,
+    PICK_BAD_CAPTURES,
+    PICK_END,
+};
+
+// Hands out the legal actions of a position one at a time, best first :
+// the hash table action, then the captures by MVV-LVA which do not lose
+// material, then the killers, then the quiet actions by history, and the
+// losing captures last. A stage is generated only when the previous one is
+// exhausted, so a cut-off on an early action saves the rest.
+class MovePicker {
+public:
+    // killers : kKillers actions, history : [from][to] of the side to move.
+    // both may be NULL.
+    MovePicker(Board* board, Turn turn, Action ttMove,
+               const Action* killers, const int (*history)[kStageSquares]);
+    // quiescence : the captures which do not lose material, nothing else.
+    MovePicker(Board* board, Turn turn);
+    Action Next(); // null action when exhausted
+    PickStage GetStage() { return stage; };
+
+    static const int kKillers = 2;
+
+private:
+    Action PickBest();
+    bool IsSearched(Action a);
+    bool IsLosingCapture(Action a);
+    bool IsQuiet(Action a) { return board->stage[a.next.y][a.next.x] < 0; };
+
+    Board* board;
+    Turn turn;
+    CheckInfo info;
+    PickStage stage;
+    Action ttMove;
+    const Action* killers;
+    const int (*history)[kStageSquares];
+    int killerIndex;
+    bool capturesOnly;
+    ActionList list;
+    ActionList badCaptures;
+    int current;
+};
+
+#endif /* move_picker_h */
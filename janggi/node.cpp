@@ -8,16 +8,21 @@
 #define node_cpp
 
 #include <vector>
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <cstdlib>
 #include <ctime>
+#include <cmath>
+#include <limits>
 
 
 #include "node.h"
 #include "board.h"
+#include "eval.h"
+#include "trace.h"
 
-Node::Node() : isLeaf(true), totalScore(0.0f), visitCount(0) {
+Node::Node() : leafValue(0), staticValue(0), hasStaticValue(false), isLeaf(true), totalScore(0.0f), visitCount(0), prior(1.0f), hash(0), link(NULL) {
   
 }
 
@@ -25,13 +30,37 @@ Node::Node(const Node& n){
     board = n.board;
     action = n.action;
     leafValue = n.leafValue;
+    staticValue = n.staticValue;
+    hasStaticValue = n.hasStaticValue;
 
     isLeaf = true;
     children.resize((int)(n.children.size()));
     std::copy(n.children.begin(), n.children.end(), children.begin());
     totalScore = n.totalScore;
+    visitCount = n.visitCount;
+    prior = n.prior;
+    hash = n.hash;
+    link = n.link;
 } // copy ctor
 
+Node& Node::operator=(const Node& n) {
+    if (this == &n)
+        return *this;
+    board = n.board;
+    action = n.action;
+    leafValue = n.leafValue;
+    staticValue = n.staticValue;
+    hasStaticValue = n.hasStaticValue;
+    children = n.children;
+    isLeaf = n.isLeaf;
+    totalScore = n.totalScore;
+    visitCount = n.visitCount;
+    prior = n.prior;
+    hash = n.hash;
+    link = n.link;
+    return *this;
+}
+
 Node::Node(Board b) :Node() {
 	board = b;
 };
@@ -41,6 +70,9 @@ void Node::Init()
   leafValue = 0;
   children.clear();
   isLeaf = true;
+  totalScore = 0.0f;
+  visitCount = 0;
+  link = NULL;
 }
 
 double Node::Rand_i()
@@ -49,7 +81,11 @@ double Node::Rand_i()
 }
 
 int Node::GetValue() {
-    return board.GetValue();
+    if (!hasStaticValue) {
+        staticValue = board.GetValue();
+        hasStaticValue = true;
+    }
+    return staticValue;
 }
 
 vector<Node> Node::GetChildren(Turn turn) {
@@ -66,58 +102,110 @@ void Node::Print() {
 void Node::DoAction(Action a) {
     action = a;
     board.DoAction(a);
+    hasStaticValue = false;
 }
 
-int Node::Selection(Turn turn)
+int Node::Selection(Turn turn, MCTSPolicy policy, double c)
 {
   // Ensure this is not a leaf node.
   assert(children.size() != 0);
   
   int selected = 0;
-
-#if 1
-  selected = rand() % children.size();
-#else
   double bestValue = -std::numeric_limits<double>::max();
-  for (int k = 0; k < children.size(); k++) {
+  double logVisits = std::log(visitCount + 1.0);
+  double sqrtVisits = std::sqrt(visitCount + 1.0);
+  for (int k = 0; k < (int)children.size(); k++) {
 
     Node* pCur = GetChild(k);
     assert(pCur != NULL);
+    Node* stats = pCur->Target(); // shared by every path reaching this position
+
+    // mean value from the point of view of the player to move
+    double q = 0.0;
+    if (stats->visitCount > 0) {
+      q = stats->totalScore / stats->visitCount;
+      if (turn == TURN_HAN)
+        q = -q;
+    }
 
-    double uctValue;
-      
-    if (turn == TURN_CHO )
-      uctValue = pCur->totalScore / (pCur->visitCount + EPSILON) +
-      std::sqrt(std::log(visitCount + 1) / (pCur->visitCount + EPSILON));
-    else
-      uctValue = -pCur->totalScore / (pCur->visitCount + EPSILON) +
-      std::sqrt(std::log(visitCount + 1) / (pCur->visitCount + EPSILON));
+    double value;
+    if (policy == MCTS_PUCT) {
+      value = q + c * pCur->prior * sqrtVisits / (1 + stats->visitCount);
+    }
+    else {
+      if (stats->visitCount == 0)
+        value = std::numeric_limits<double>::max() / 2; // try every child once
+      else
+        value = q + c * std::sqrt(logVisits / stats->visitCount);
+    }
 
-    uctValue += Rand_i()*EPSILON;
+    value += Rand_i()*EPSILON;
 
-    if (uctValue >= bestValue)
+    if (value >= bestValue)
     {
       selected = k;
-      bestValue = uctValue;
+      bestValue = value;
     }
   }
-#endif
   return selected;
 }
 
-void Node::Expand(Turn turn)
+static const int kMaxBatch = 128;
+
+// Returns false when the pool refuses to grow the tree.
+bool Node::Expand(Turn turn, NodePool* pool, bool force)
 {
   if (!isLeaf)
-    return;
+    return true;
+  TRACE_SCOPE("Node::Expand");
 
+  vector<Action> acts = board.GetLegalActions(turn);
+  if (pool) {
+    if (!pool->Acquire(acts.size(), children, force))
+      return false;
+  }
+  else {
+    children.clear();
+    children.reserve(acts.size());
+  }
   isLeaf = false;    
-  children.clear();
-  vector<Action> acts = board.GetPossibleActions(turn);
   for (Action a : acts) {
     Node n(board);
+    n.hash = board.UpdateHash(hash, a);
     n.DoAction(a);
     children.push_back(n);
-  }  
+  }
+  if (children.empty())
+    return true;
+
+  // all the children are evaluated in one batch
+  const Board* boards[kMaxBatch];
+  int values[kMaxBatch];
+  for (size_t start = 0; start < children.size(); start += kMaxBatch) {
+    int count = (int)std::min(children.size() - start, (size_t)kMaxBatch);
+    for (int i = 0; i < count; i++)
+      boards[i] = &children[start + i].board;
+    EvaluateBoards(boards, count, values);
+    for (int i = 0; i < count; i++) {
+      children[start + i].staticValue = values[i];
+      children[start + i].hasStaticValue = true;
+    }
+  }
+
+  // priors : softmax of the material gained by each action.
+  int value = GetValue();
+  double sum = 0.0;
+  for (Node& n : children) {
+    double gain = (double)n.GetValue() - value;
+    if (turn == TURN_HAN)
+      gain = -gain;
+    gain = std::max(-20.0, std::min(20.0, gain)); // capturing the general would overflow exp()
+    n.prior = std::exp(gain / MCTS_PRIOR_TEMPERATURE);
+    sum += n.prior;
+  }
+  for (Node& n : children)
+    n.prior /= sum;
+  return true;
 }
 
 Node* Node::GetChild(int idx)
@@ -129,13 +217,91 @@ Node* Node::GetChild(int idx)
 }
 double Node::GetScore()
 {
-#if 0
   if (visitCount == 0)
     return 0.0f;
   return totalScore/visitCount;
-#else
-  return totalScore;
-#endif
+}
+
+void Node::Update(double value)
+{
+  visitCount++;
+  totalScore += value;
+}
+
+// counts a pending evaluation as a visit with a bad outcome, so that the
+// next selections of the same batch prefer other paths.
+void Node::AddVirtualLoss(double score)
+{
+  visitCount++;
+  totalScore += score;
+}
+
+void Node::RevertVirtualLoss(double score)
+{
+  visitCount--;
+  totalScore -= score;
+}
+
+NodePool::NodePool() : budget(0), allocated(0), pooled(0)
+{
+}
+
+// Gives children (empty) room for count nodes. A pooled array is reused if
+// one is large enough, otherwise a new one is allocated within the budget,
+// dropping smaller pooled arrays to make room. force ignores the budget.
+bool NodePool::Acquire(size_t count, vector<Node>& children, bool force)
+{
+  size_t cls = (count + kGranularity - 1) / kGranularity;
+  for (size_t c = cls; c < buckets.size(); c++) {
+    if (!buckets[c].empty()) {
+      children.swap(buckets[c].back());
+      buckets[c].pop_back();
+      pooled -= children.capacity();
+      return true;
+    }
+  }
+
+  size_t capacity = cls * kGranularity;
+  for (size_t c = 0; c < cls && c < buckets.size(); c++) {
+    while (!force && budget != 0 && allocated + capacity > budget && !buckets[c].empty()) {
+      size_t freed = buckets[c].back().capacity();
+      buckets[c].pop_back();
+      pooled -= freed;
+      allocated -= freed;
+    }
+  }
+  if (!force && budget != 0 && allocated + capacity > budget)
+    return false;
+
+  vector<Node>().swap(children);
+  children.reserve(capacity);
+  allocated += children.capacity();
+  return true;
+}
+
+// Takes back children and, recursively, the arrays of its descendants.
+// Returns the number of nodes destroyed; their addresses go to released.
+size_t NodePool::Release(vector<Node>& children, unordered_set<Node*>* released)
+{
+  size_t count = children.size();
+  for (Node& n : children) {
+    if (n.children.capacity() != 0)
+      count += Release(n.children, released);
+    if (released)
+      released->insert(&n);
+  }
+  children.clear();
+
+  size_t capacity = children.capacity();
+  if (capacity == 0)
+    return count;
+  size_t cls = capacity / kGranularity;
+  if (buckets.size() <= cls)
+    buckets.resize(cls + 1);
+  buckets[cls].push_back(vector<Node>());
+  buckets[cls].back().swap(children);
+  pooled += capacity;
+  return count;
 }
 
 #endif /* node_cpp */
@@ -8,21 +8,30 @@
 #define node_h
 
 #include <vector>
+#include <unordered_set>
 #include "board.h"
 
+class NodePool;
+
 class Node{
 public:
     Board board = Board();
     Action action = Action(); // from before state, this action makes this board.
     int leafValue;
+    int staticValue;     // board.GetValue(), valid if hasStaticValue
+    bool hasStaticValue;
 
     vector<Node> children;
     bool isLeaf;
-    double totalScore;
+    double totalScore; // sum of the backed-up values, from cho's point of view
     int    visitCount;
+    double prior;      // probability of the action that made this node, used by PUCT
+    uint64_t hash;     // position hash with the player to move at this node
+    Node*  link;       // node holding the statistics of this position when it is a transposition
     
     Node();
     Node(const Node& n); // copy ctor
+    Node& operator=(const Node& n); // children copied too : swap them out first to move a node
     Node(Board b);
     void Init();    
     double Rand_i();
@@ -36,9 +45,33 @@ public:
     void DoAction(Action a);
     int GetLeafValue() { return leafValue; };
     void SetLeafValue(int v) { leafValue = v; };
+    Node* Target() { return link ? link : this; };
     double GetScore();
-    int Selection(Turn turn);
-    void Expand(Turn turn);
+    void Update(double value);
+    void AddVirtualLoss(double score);
+    void RevertVirtualLoss(double score);
+    int Selection(Turn turn, MCTSPolicy policy, double c);
+    bool Expand(Turn turn, NodePool* pool = NULL, bool force = false);
+};
+
+// Owns the storage of the children arrays of a search tree. Released arrays
+// are kept by capacity and handed back to later expansions, and no new array
+// is allocated past the budget.
+class NodePool {
+public:
+    NodePool();
+    void SetBudget(size_t nodes) { budget = nodes; }; // 0 : unlimited
+    bool Acquire(size_t count, vector<Node>& children, bool force);
+    size_t Release(vector<Node>& children, unordered_set<Node*>* released = NULL);
+    size_t GetAllocatedNodes() { return allocated; };
+    size_t GetLiveNodes() { return allocated - pooled; };
+
+private:
+    vector<vector<vector<Node> > > buckets; // [capacity / kGranularity]
+    size_t budget;
+    size_t allocated; // capacity of every array owned, in use or pooled
+    size_t pooled;
+    static const size_t kGranularity = 8;
 };
 
 #endif /* node_h */
\ No newline at end of file
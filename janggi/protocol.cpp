@@ -0,0 +1,294 @@
+//
+//  protocol.cpp
+//
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include "protocol.h"
+#include "eval.h"
+
+static string ActionToString(Action a)
+{
+    if (a.IsNull())
+        return "none";
+    char s[5] = { (char)('0' + a.prev.x), (char)('0' + a.prev.y), (char)('0' + a.next.x), (char)('0' + a.next.y), 0 };
+    return s;
+}
+
+Protocol::Protocol(const EngineConfig& engineConfig) : search(engine), config(engineConfig), out(&cout), held(false), finished(true),
+    answered(true), moveTime(0.0), startTurn(TURN_CHO), performed(-1), turn(TURN_CHO)
+{
+    config.Apply(engine);
+    engine.SetHashSize(TT_SIZE_MB);
+    engine.GetMateSolver().Resize(MATE_TT_SIZE_MB);
+    engine.SetProgressCallback([this](const SearchResult& r) {
+        ostringstream info;
+        if (r.iterations > 0)
+            info << "info iterations " << r.iterations;
+        else
+            info << "info depth " << r.depth << " nodes " << r.nodes;
+        info << " multipv " << r.rank;
+        info << " score " << r.score << " time " << (long long)(r.seconds * 1000) << " pv";
+        if (r.pv.empty())
+            info << " " << ActionToString(r.action);
+        for (Action a : r.pv)
+            info << " " << ActionToString(a);
+        Send(info.str());
+    });
+}
+
+void Protocol::Run(istream& in, ostream& output)
+{
+    out = &output;
+    string line;
+    while (getline(in, line)) {
+        istringstream args(line);
+        string command;
+        if (!(args >> command))
+            continue;
+        if (command == "quit")
+            break;
+        else if (command == "isready")
+            Send("readyok");
+        else if (command == "newgame") {
+            StopSearch();
+            engine.NewGame();
+            performed = -1;
+        }
+        else if (command == "setoption")
+            SetOption(args);
+        else if (command == "position")
+            SetPosition(args);
+        else if (command == "go")
+            Go(args);
+        else if (command == "stop")
+            StopSearch();
+        else if (command == "ponderhit")
+            PonderHit();
+        else if (command == "savetree" || command == "loadtree")
+            TreeFile(command, args);
+        else if (command == "stats") { // of the last search, then of all
+            if (search.IsRunning()) // waiting would block a stop or ponderhit
+                Send("info string searching");
+            else {
+                Send("info string stats " + engine.GetStats().ToJSON());
+                Send("info string total " + engine.GetTotalStats().ToJSON());
+            }
+        }
+        else
+            Send("info string unknown command " + command);
+    }
+    StopSearch();
+}
+
+void Protocol::SetOption(istringstream& args)
+{
+    string token, name, value;
+    args >> token >> name >> token >> value;
+    if (name == "MultiPV" && token == "value" && atoi(value.c_str()) > 0) {
+        StopSearch();
+        engine.SetMultiPV(atoi(value.c_str()));
+    }
+    else if (name == "BookFile" && token == "value" && !value.empty()) {
+        StopSearch();
+        if (!engine.SetBookPath(value == "none" ? "" : value))
+            Send("info string no book " + value);
+    }
+    else if (name == "TablebasePath" && token == "value" && !value.empty()) {
+        StopSearch();
+        engine.SetTablebasePath(value == "none" ? "" : value);
+    }
+    else if (name == "EvalFile" && token == "value" && !value.empty()) {
+        StopSearch();
+        if (!LoadEvalParams(value))
+            Send("info string no eval file " + value);
+    }
+    else if (name == "SharedHash" && token == "value" && !value.empty()) {
+        StopSearch();
+        if (!engine.SetSharedHash(value, TT_SIZE_MB))
+            Send("info string no shared hash " + value);
+    }
+    else
+        Send("info string unknown option " + name);
+}
+
+// the position of a loaded tree is set as with "position fen", so that a
+// position continuing it keeps the tree.
+void Protocol::TreeFile(const string& command, istringstream& args)
+{
+    string path;
+    args >> path;
+    StopSearch();
+    if (command == "savetree") {
+        if (performed < 0 || !engine.SaveTree(path, turn))
+            Send("info string can not write " + path);
+        return;
+    }
+    Board b;
+    Turn t;
+    if (!engine.LoadTree(path, b, t)) {
+        Send("info string not a tree " + path);
+        return;
+    }
+    start = board = b;
+    startTurn = turn = t;
+    moves.clear();
+    performed = 0;
+}
+
+void Protocol::SetPosition(istringstream& args)
+{
+    StopSearch();
+    Board newStart;
+    Turn newTurn = TURN_CHO;
+    string token;
+    args >> token;
+    if (token == "fen") {
+        string placement, side;
+        args >> placement >> side;
+        if (!newStart.SetFromFEN(placement + " " + side, newTurn)) {
+            Send("info string not a position");
+            return;
+        }
+        token = "";
+        args >> token;
+    }
+    else if (token == "startpos") {
+        token = "";
+        args >> token;
+    }
+    else {
+        Send("info string not a position");
+        return;
+    }
+
+    vector<Action> newMoves;
+    Board b(newStart);
+    Turn t = newTurn;
+    if (token == "moves") {
+        while (args >> token) {
+            Action a;
+            if (token.size() == 4)
+                a = Action(token[0] - '0', token[1] - '0', token[2] - '0', token[3] - '0');
+            if (token.size() != 4 || !b.IsPossibleAction(a, t)) {
+                Send("info string illegal move " + token);
+                break;
+            }
+            newMoves.push_back(a);
+            b.DoAction(a);
+            t = (t == TURN_CHO ? TURN_HAN : TURN_CHO);
+        }
+    }
+
+    // the engine goes on from where it is when the new position continues
+    // the last one, which keeps its tree.
+    bool continues = performed >= 0 && startTurn == newTurn &&
+        memcmp(start.stage, newStart.stage, sizeof(start.stage)) == 0 &&
+        newMoves.size() >= moves.size() && equal(moves.begin(), moves.end(), newMoves.begin());
+    if (!continues) {
+        engine.SetPosition(newStart);
+        performed = 0;
+    }
+    for (size_t i = performed; i < newMoves.size(); i++)
+        engine.PerformAction(newMoves[i]);
+    performed = (int)newMoves.size();
+    start = newStart;
+    startTurn = newTurn;
+    moves = newMoves;
+    board = b;
+    turn = t;
+}
+
+void Protocol::Go(istringstream& args)
+{
+    StopSearch();
+    if (performed < 0) {
+        engine.SetPosition(board);
+        performed = (int)moves.size();
+    }
+    int depth = 0, iterations = 0;
+    double seconds = 0.0;
+    bool infinite = false, ponder = false;
+    string token;
+    while (args >> token) {
+        if (token == "depth")
+            args >> depth;
+        else if (token == "iterations")
+            args >> iterations;
+        else if (token == "movetime") {
+            int ms = 0;
+            args >> ms;
+            seconds = ms / 1000.0;
+        }
+        else if (token == "infinite")
+            infinite = true;
+        else if (token == "ponder")
+            ponder = true;
+    }
+    // a time limit alone leaves the depth and iterations open
+    bool timed = infinite || (seconds > 0 && depth == 0 && iterations == 0);
+    if (depth <= 0)
+        depth = timed ? MAX_PLY / 2 : config.depth;
+    if (iterations <= 0)
+        iterations = timed ? INT_MAX : config.iterations;
+    engine.SetSearch(config.type, depth);
+    engine.SetMCTSBudget(iterations, 0.0);
+
+    lock_guard<mutex> guard(lock);
+    held = ponder || infinite;
+    finished = false;
+    answered = false;
+    moveTime = seconds;
+    Turn side = turn;
+    search.Start(side, ponder ? 0.0 : seconds, [this, side](const SearchResult& r) { Finish(r, side); });
+}
+
+// called by the search as it ends.
+void Protocol::Finish(const SearchResult& result, Turn side)
+{
+    string line = "bestmove " + ActionToString(result.action);
+    Action reply = result.action.IsNull() ? Action() : engine.GetExpectedReply(result.action, side);
+    if (!reply.IsNull())
+        line += " ponder " + ActionToString(reply);
+
+    lock_guard<mutex> guard(lock);
+    answer = line;
+    finished = true;
+    Answer();
+}
+
+void Protocol::Answer()
+{
+    if (finished && !held && !answered) {
+        Send(answer);
+        answered = true;
+    }
+}
+
+void Protocol::PonderHit()
+{
+    lock_guard<mutex> guard(lock);
+    if (!held)
+        return;
+    held = false;
+    if (!finished && moveTime > 0)
+        engine.SetDeadline(moveTime);
+    Answer();
+}
+
+void Protocol::StopSearch()
+{
+    search.Stop();
+    search.Wait();
+    lock_guard<mutex> guard(lock);
+    held = false;
+    Answer();
+}
+
+void Protocol::Send(const string& line)
+{
+    lock_guard<mutex> guard(outputLock);
+    *out << line << endl;
+}
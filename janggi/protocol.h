@@ -0,0 +1,78 @@
+//
+//  protocol.h
+//
+
+#ifndef protocol_h
+#define protocol_h
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include "defines.h"
+#include "janggi.h"
+#include "async_search.h"
+#include "tournament.h"
+
+// A long-lived engine driven by text commands, one a line :
+//   position startpos [moves <xyxy> ...]
+//   position fen <placement> <w|b> [moves <xyxy> ...]
+//   go [depth <d>] [iterations <n>] [movetime <ms>] [infinite] [ponder]
+//   setoption name MultiPV value <k>
+//   setoption name SharedHash value <name> : the hash table shared with the
+//     engines using name
+//   setoption name BookFile value <file|none>
+//   setoption name TablebasePath value <dir|none> : none by default,
+//     BOOK_PATH and TB_PATH are where bookgen and tbgen write
+//   setoption name EvalFile value <file> : evaluation weights, as tune
+//     writes them to EVAL_PARAMS_PATH
+//   savetree <file>, loadtree <file> : the MCTS tree of the position, the
+//     position of the tree loaded becomes the position
+//   stop, ponderhit, newgame, isready, stats, quit
+// A search runs on its own thread, writes "info ..." as it goes and
+// answers "bestmove <xyxy> [ponder <xyxy>]". With MultiPV, each depth
+// writes an info for each of the k best lines, "multipv 1" first. The
+// engine and its tables live from move to move, and a new position which
+// continues the previous one keeps the MCTS tree. While pondering, or
+// searching with infinite, the answer waits for ponderhit or stop;
+// ponderhit turns the search into a normal one, movetime counting from
+// then.
+class Protocol {
+public:
+    Protocol(const EngineConfig& config);
+    ~Protocol() { StopSearch(); };
+    void Run(istream& in, ostream& out);
+
+private:
+    void SetOption(istringstream& args);
+    void TreeFile(const string& command, istringstream& args);
+    void SetPosition(istringstream& args);
+    void Go(istringstream& args);
+    void PonderHit();
+    void StopSearch(); // returns once the answer is written
+    void Finish(const SearchResult& result, Turn turn);
+    void Answer(); // writes the answer if the search ended and nothing holds it. called with lock held
+    void Send(const string& line);
+
+    Janggi engine;
+    AsyncSearch search;
+    EngineConfig config;
+    ostream* out;
+    mutex outputLock;
+    mutex lock;        // the fields below shared with the search
+    bool held;         // pondering or infinite : no answer before ponderhit or stop
+    bool finished;     // the search ended
+    bool answered;
+    string answer;
+    double moveTime;   // seconds given by go, 0 : none
+
+    Board start;       // the position given, the start and the moves played since
+    Turn startTurn;
+    vector<Action> moves;
+    int performed;     // moves the engine has played, -1 : not set
+    Board board;       // position reached
+    Turn turn;
+};
+
+#endif /* protocol_h */
@@ -0,0 +1,222 @@
+//
+//  record.cpp
+//
+
+#include <cstring>
+#include <sstream>
+#include "record.h"
+
+// Text records hold one game a line : the start position in FEN when it
+// is not the initial one, the moves as "xyxy" (from x, y, to x, y) and
+// the result, "1-0" (cho won), "0-1", "1/2-1/2" or "*".
+static const char* kResultText[] = { "0-1", "1/2-1/2", "1-0", "*" };
+
+bool GameRecord::IsInitialStart()
+{
+    Board initial;
+    return turn == TURN_CHO && memcmp(initial.stage, start.stage, sizeof(start.stage)) == 0;
+}
+
+string GameRecord::ToText()
+{
+    string s;
+    if (!IsInitialStart())
+        s += start.ToFEN(turn) + " ";
+    for (Action a : moves) {
+        char m[5] = { (char)('0' + a.prev.x), (char)('0' + a.prev.y), (char)('0' + a.next.x), (char)('0' + a.next.y), 0 };
+        s += m;
+        s += " ";
+    }
+    s += kResultText[(result >= RESULT_HAN_WIN && result <= RESULT_UNKNOWN ? result : RESULT_UNKNOWN) + 1];
+    return s;
+}
+
+bool GameRecord::FromText(const string& line)
+{
+    istringstream in(line);
+    string token;
+    start = Board();
+    turn = TURN_CHO;
+    moves.clear();
+    result = RESULT_UNKNOWN;
+    while (in >> token) {
+        if (token.find('/') != string::npos && token.find('-') == string::npos) { // a FEN placement
+            string side;
+            in >> side;
+            if (!moves.empty() || !start.SetFromFEN(token + " " + side, turn))
+                return false;
+            continue;
+        }
+        for (int r = 0; r < 4; r++) {
+            if (token == kResultText[r]) {
+                result = (GameResult)(r - 1);
+                return true;
+            }
+        }
+        if (token.size() != 4 || (int)moves.size() >= kRecordMaxMoves)
+            return false;
+        for (char c : token) {
+            if (c < '0' || c > '9')
+                return false;
+        }
+        Action a(token[0] - '0', token[1] - '0', token[2] - '0', token[3] - '0');
+        if (!a.IsOnStage())
+            return false;
+        moves.push_back(a);
+    }
+    return true;
+}
+
+bool GameRecordWriter::Open(const string& path, bool append)
+{
+    Close();
+    file = fopen(path.c_str(), append ? "ab" : "wb");
+    if (file == NULL)
+        return false;
+    if (ftell(file) == 0) {
+        RecordFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "JGR1", 4);
+        fwrite(&header, sizeof(header), 1, file);
+    }
+    games = 0;
+    return true;
+}
+
+bool GameRecordWriter::Close()
+{
+    if (file == NULL)
+        return true;
+    bool ok = fclose(file) == 0;
+    file = NULL;
+    return ok;
+}
+
+bool GameRecordWriter::Write(GameRecord& game)
+{
+    if (file == NULL || game.moves.size() > (size_t)kRecordMaxMoves)
+        return false;
+    GameHeader header;
+    header.moveCount = (uint16_t)game.moves.size();
+    header.result = (int8_t)game.result;
+    header.flags = game.IsInitialStart() ? 0 : kRecordCustomStart;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (header.flags & kRecordCustomStart) {
+        RecordPosition position;
+        for (int y = 0; y < kStageHeight; y++) {
+            for (int x = 0; x < kStageWidth; x++)
+                position.squares[y * kStageWidth + x] = (uint8_t)(game.start.stage[y][x] + 1);
+        }
+        position.turn = (uint8_t)game.turn;
+        position.reserved = 0;
+        ok = ok && fwrite(&position, sizeof(position), 1, file) == 1;
+    }
+    uint16_t packed[256];
+    for (size_t i = 0; ok && i < game.moves.size(); i += 256) {
+        size_t n = min(game.moves.size() - i, (size_t)256);
+        for (size_t k = 0; k < n; k++)
+            packed[k] = game.moves[i + k].Pack();
+        ok = fwrite(packed, sizeof(uint16_t), n, file) == n;
+    }
+    if (ok)
+        games++;
+    return ok;
+}
+
+void GameRecordWriter::BeginGame(Board& start, Turn turn)
+{
+    current.start = start;
+    current.turn = turn;
+    current.moves.clear();
+}
+
+bool GameRecordWriter::EndGame(GameResult result)
+{
+    current.result = result;
+    return Write(current);
+}
+
+void GameView::GetStart(Board& board, Turn& turn)
+{
+    if (position == NULL) {
+        board = Board();
+        turn = TURN_CHO;
+        return;
+    }
+    for (int y = 0; y < kStageHeight; y++) {
+        for (int x = 0; x < kStageWidth; x++)
+            board.stage[y][x] = (int)position->squares[y * kStageWidth + x] - 1;
+    }
+    turn = (Turn)position->turn;
+}
+
+void GameView::ToRecord(GameRecord& game)
+{
+    GetStart(game.start, game.turn);
+    game.moves.resize(GetMoveCount());
+    for (int i = 0; i < GetMoveCount(); i++)
+        game.moves[i] = GetMove(i);
+    game.result = GetResult();
+}
+
+bool GameRecordReader::Open(const string& path)
+{
+    if (!file.Open(path))
+        return false;
+    if (file.GetSize() < sizeof(RecordFileHeader) || memcmp(file.GetData(), "JGR1", 4) != 0) {
+        file.Close();
+        return false;
+    }
+    Rewind();
+    return true;
+}
+
+bool GameRecordReader::Next(GameView& game)
+{
+    const uint8_t* data = file.GetData();
+    size_t size = file.GetSize();
+    if (data == NULL || error || offset >= size)
+        return false;
+    if (size - offset < sizeof(GameHeader)) {
+        error = true;
+        return false;
+    }
+    game.header = (const GameHeader*)(data + offset);
+    size_t length = sizeof(GameHeader) + game.header->moveCount * sizeof(uint16_t);
+    bool custom = (game.header->flags & kRecordCustomStart) != 0;
+    if (custom)
+        length += sizeof(RecordPosition);
+    if (size - offset < length) {
+        error = true;
+        return false;
+    }
+    game.position = custom ? (const RecordPosition*)(data + offset + sizeof(GameHeader)) : NULL;
+    game.moves = (const uint16_t*)(data + offset + length - game.header->moveCount * sizeof(uint16_t));
+    if (!IsSound(game)) {
+        error = true;
+        return false;
+    }
+    offset += length;
+    return true;
+}
+
+// the bytes of a game index tables once read : units, turn, result and
+// the squares of the moves must be in range.
+bool GameRecordReader::IsSound(GameView& game)
+{
+    if (game.header->result < RESULT_HAN_WIN || game.header->result > RESULT_UNKNOWN)
+        return false;
+    if (game.position) {
+        for (int i = 0; i < kStageSquares; i++) {
+            if (game.position->squares[i] > IDSize)
+                return false;
+        }
+        if (game.position->turn != TURN_CHO && game.position->turn != TURN_HAN)
+            return false;
+    }
+    for (int i = 0; i < game.GetMoveCount(); i++) {
+        if (!game.GetMove(i).IsOnStage())
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,113 @@
+//
+//  record.h
+//
+
+#ifndef record_h
+#define record_h
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include "defines.h"
+#include "board.h"
+#include "mapped_file.h"
+
+enum GameResult {
+    RESULT_HAN_WIN = -1,
+    RESULT_DRAW = 0,
+    RESULT_CHO_WIN = 1,
+    RESULT_UNKNOWN = 2,
+};
+
+// A game in memory.
+struct GameRecord {
+    Board start;
+    Turn turn; // to move at start
+    vector<Action> moves;
+    GameResult result;
+
+    GameRecord() : turn(TURN_CHO), result(RESULT_UNKNOWN) {};
+    bool IsInitialStart(); // start is Board() with cho to move
+    string ToText();
+    bool FromText(const string& line);
+};
+
+// Binary records : a RecordFileHeader, then for each game a GameHeader,
+// a RecordPosition if the game does not start from the initial position,
+// and the moves packed by Action::Pack(), 2 bytes each. Every part has an
+// even size, so the moves of a mapped file can be read in place.
+struct RecordFileHeader {
+    char magic[4]; // "JGR1"
+    uint32_t reserved[3];
+};
+
+struct GameHeader {
+    uint16_t moveCount;
+    int8_t result;  // GameResult
+    uint8_t flags;  // kRecordCustomStart
+};
+
+struct RecordPosition {
+    uint8_t squares[kStageSquares]; // unit id + 1, 0 : empty
+    uint8_t turn;
+    uint8_t reserved;
+};
+
+const uint8_t kRecordCustomStart = 1;
+const int kRecordMaxMoves = 0xFFFF;
+
+// Appends games to a file through a buffered stream, one at a time or one
+// move at a time.
+class GameRecordWriter {
+public:
+    GameRecordWriter() : file(NULL), games(0) {};
+    ~GameRecordWriter() { Close(); };
+    bool Open(const string& path, bool append = false);
+    bool Close();
+    bool Write(GameRecord& game);
+    void BeginGame(Board& start, Turn turn);
+    void AddMove(Action a) { current.moves.push_back(a); };
+    bool EndGame(GameResult result);
+    long long GetGames() { return games; };
+
+private:
+    GameRecordWriter(const GameRecordWriter&);
+    GameRecordWriter& operator=(const GameRecordWriter&);
+
+    FILE* file;
+    GameRecord current;
+    long long games;
+};
+
+// A game read in place from a mapped file.
+struct GameView {
+    const GameHeader* header;
+    const RecordPosition* position; // NULL : the initial position, cho to move
+    const uint16_t* moves;          // header->moveCount packed actions
+
+    int GetMoveCount() { return header->moveCount; };
+    Action GetMove(int i) { return Action::Unpack(moves[i]); };
+    GameResult GetResult() { return (GameResult)header->result; };
+    void GetStart(Board& board, Turn& turn);
+    void ToRecord(GameRecord& game);
+};
+
+// Walks over the games of a file without copying them.
+class GameRecordReader {
+public:
+    GameRecordReader() : offset(0), error(false) {};
+    bool Open(const string& path);
+    void Close() { file.Close(); };
+    bool Next(GameView& game); // false at the end, or on a damaged record, one out of range included
+    void Rewind() { offset = sizeof(RecordFileHeader); error = false; };
+    bool IsDamaged() { return error; };
+
+private:
+    bool IsSound(GameView& game);
+
+    MappedFile file;
+    size_t offset;
+    bool error;
+};
+
+#endif /* record_h */
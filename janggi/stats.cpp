@@ -0,0 +1,71 @@
+//
+//  stats.cpp
+//
+
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include "stats.h"
+
+void SearchStats::Clear()
+{
+    searches = 0;
+    seconds = 0.0;
+    nodes = quiescenceNodes = interiorNodes = 0;
+    cutoffs = firstCutoffs = 0;
+    ttProbes = ttHits = 0;
+    depth = maxPly = 0;
+    branchingLogSum = 0.0;
+    branchingSearches = 0;
+    playouts = treeNodes = 0;
+    treeDepth = 0;
+}
+
+void SearchStats::Add(const SearchStats& s)
+{
+    searches += s.searches;
+    seconds += s.seconds;
+    nodes += s.nodes;
+    quiescenceNodes += s.quiescenceNodes;
+    interiorNodes += s.interiorNodes;
+    cutoffs += s.cutoffs;
+    firstCutoffs += s.firstCutoffs;
+    ttProbes += s.ttProbes;
+    ttHits += s.ttHits;
+    depth = max(depth, s.depth);
+    maxPly = max(maxPly, s.maxPly);
+    branchingLogSum += s.branchingLogSum;
+    branchingSearches += s.branchingSearches;
+    playouts += s.playouts;
+    treeNodes = max(treeNodes, s.treeNodes);
+    treeDepth = max(treeDepth, s.treeDepth);
+}
+
+void SearchStats::SetBranching(long long n, int d)
+{
+    if (n <= 1 || d <= 0)
+        return;
+    branchingLogSum = log((double)n) / d;
+    branchingSearches = 1;
+}
+
+// geometric mean over the searches
+double SearchStats::GetBranchingFactor()
+{
+    return branchingSearches ? exp(branchingLogSum / branchingSearches) : 0.0;
+}
+
+string SearchStats::ToJSON()
+{
+    char s[1024];
+    snprintf(s, sizeof(s),
+        "{\"searches\":%lld,\"seconds\":%.6f,\"nodes\":%lld,\"quiescence_nodes\":%lld,\"nps\":%.0f,"
+        "\"depth\":%d,\"max_ply\":%d,\"branching_factor\":%.3f,\"cutoff_rate\":%.4f,\"first_cutoff_rate\":%.4f,"
+        "\"tt_probes\":%lld,\"tt_hits\":%lld,\"tt_hit_rate\":%.4f,"
+        "\"playouts\":%lld,\"playouts_per_second\":%.0f,\"tree_nodes\":%lld,\"tree_depth\":%d}",
+        searches, seconds, nodes, quiescenceNodes, GetNodesPerSecond(),
+        depth, maxPly, GetBranchingFactor(), GetCutoffRate(), GetFirstCutoffRate(),
+        ttProbes, ttHits, GetTTHitRate(),
+        playouts, GetPlayoutsPerSecond(), treeNodes, treeDepth);
+    return s;
+}
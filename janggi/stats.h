@@ -0,0 +1,43 @@
+//
+//  stats.h
+//
+
+#ifndef stats_h
+#define stats_h
+
+#include <string>
+#include "defines.h"
+
+// Counters of a search, or of many searches added together.
+struct SearchStats {
+    long long searches;
+    double seconds;
+    long long nodes;           // minmax, alpha-beta and quiescence nodes
+    long long quiescenceNodes; // below the alpha-beta leaves
+    long long interiorNodes;   // alpha-beta nodes whose actions were searched
+    long long cutoffs;         // interior nodes cut off
+    long long firstCutoffs;    // interior nodes cut off by their first action
+    long long ttProbes;        // transposition table, and MCTS transposition nodes
+    long long ttHits;
+    int depth;                 // deepest completed alpha-beta or minmax depth
+    int maxPly;                // deepest alpha-beta or quiescence node
+    double branchingLogSum;    // log of the branching factor, summed over the searches with a depth
+    long long branchingSearches;
+    long long playouts;        // MCTS iterations
+    long long treeNodes;       // MCTS nodes held at the end
+    int treeDepth;             // deepest MCTS selection
+
+    SearchStats() { Clear(); };
+    void Clear();
+    void Add(const SearchStats& s);
+    void SetBranching(long long nodes, int depth); // effective branching factor of a search, nodes = b^depth
+    double GetNodesPerSecond() { return seconds > 0 ? nodes / seconds : 0.0; };
+    double GetBranchingFactor();
+    double GetCutoffRate() { return interiorNodes ? (double)cutoffs / interiorNodes : 0.0; };
+    double GetFirstCutoffRate() { return cutoffs ? (double)firstCutoffs / cutoffs : 0.0; };
+    double GetTTHitRate() { return ttProbes ? (double)ttHits / ttProbes : 0.0; };
+    double GetPlayoutsPerSecond() { return seconds > 0 ? playouts / seconds : 0.0; };
+    string ToJSON();
+};
+
+#endif /* stats_h */
@@ -0,0 +1,439 @@
+//
+//  tablebase.cpp
+//
+//  Generation works forward over all the indexes, once per distance : at
+//  iteration n a position is won in n plies if an action reaches a position
+//  lost in n - 1, and lost in n if every action reaches a position won in
+//  less. Each iteration reads the previous table and writes a copy, so the
+//  threads share nothing but the index range.
+//
+
+#include <cstring>
+#include <cstdio>
+#include <cctype>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <sys/stat.h>
+#include "tablebase.h"
+
+const uint8_t Tablebase::kCodeDraw;
+const uint8_t Tablebase::kCodeLoss;
+const uint8_t Tablebase::kCodeInvalid;
+const int Tablebase::kMaxDistance;
+
+static const uint64_t kBlock = 1 << 14;   // indexes handed to a thread at once
+
+static bool IsPalaceUnit(int id)
+{
+    return id == HG || id == CG || id == Hs || id == Cs;
+}
+
+// i-th point of the palace of the owner of id
+static Pos PalacePoint(int id, int i)
+{
+    int top = (id > 6 ? 7 : 0);
+    return Pos(3 + i % 3, top + i / 3);
+}
+
+static void ParallelFor(uint64_t size, int threads, const function<void(uint64_t, uint64_t)>& work)
+{
+    atomic<uint64_t> next(0);
+    auto worker = [&]() {
+        uint64_t begin;
+        while ((begin = next.fetch_add(kBlock)) < size)
+            work(begin, min(size, begin + kBlock));
+    };
+    vector<thread> pool;
+    for (int i = 1; i < threads; i++)
+        pool.push_back(thread(worker));
+    worker();
+    for (thread& t : pool)
+        t.join();
+}
+
+Tablebase::Tablebase() : size(0), maxDistance(0), data(NULL), failed(false)
+{
+    for (int i = 0; i < IDSize; i++) {
+        firstSlot[i] = -1;
+        unitCount[i] = 0;
+        subtables[i] = NULL;
+    }
+}
+
+bool Tablebase::SetMaterial(const string& m)
+{
+    units.clear();
+    squares.clear();
+    for (int i = 0; i < IDSize; i++) {
+        firstSlot[i] = -1;
+        unitCount[i] = 0;
+    }
+    for (char c : m) {
+        const char* p = strchr(kUnitLetters, toupper(c));
+        if (c == '\0' || p == NULL)
+            return false;
+        int id = (int)(p - kUnitLetters) + (isupper(c) ? CG : HG);
+        units.push_back(id);
+    }
+    if ((int)units.size() > TB_MAX_UNITS)
+        return false;
+    // grouped by id, so that equal units take consecutive slots
+    sort(units.begin(), units.end(), [](int a, int b) { return (a > 6) != (b > 6) ? a > 6 : a < b; });
+    size = 2;
+    for (int i = 0; i < (int)units.size(); i++) {
+        if (firstSlot[units[i]] < 0)
+            firstSlot[units[i]] = i;
+        unitCount[units[i]]++;
+        squares.push_back(IsPalaceUnit(units[i]) ? 9 : kStageSquares);
+        size *= squares.back();
+    }
+    if (unitCount[CG] != 1 || unitCount[HG] != 1)
+        return false;
+    material.clear();
+    for (int id : units)
+        material += (char)(id > 6 ? kUnitLetters[id - CG] : tolower(kUnitLetters[id - HG]));
+    return true;
+}
+
+string Tablebase::GetMaterial(Board& board)
+{
+    int count[IDSize] = {0};
+    for (int y = 0; y < kStageHeight; y++) {
+        for (int x = 0; x < kStageWidth; x++) {
+            if (board.stage[y][x] >= 0)
+                count[board.stage[y][x]]++;
+        }
+    }
+    string m;
+    for (int id = CG; id < IDSize; id++)
+        m.append(count[id], kUnitLetters[id - CG]);
+    for (int id = HG; id < CG; id++)
+        m.append(count[id], (char)tolower(kUnitLetters[id - HG]));
+    return m;
+}
+
+bool Tablebase::GetIndex(Board& board, Turn turn, uint64_t& index)
+{
+    int seen[IDSize] = {0};
+    uint64_t square[TB_MAX_UNITS];
+    int found = 0;
+    for (int y = 0; y < kStageHeight; y++) {
+        for (int x = 0; x < kStageWidth; x++) {
+            int id = board.stage[y][x];
+            if (id < 0)
+                continue;
+            if (seen[id] >= unitCount[id])
+                return false;
+            int slot = firstSlot[id] + seen[id]++;
+            if (IsPalaceUnit(id)) {
+                int top = (id > 6 ? 7 : 0);
+                if (x < 3 || x > 5 || y < top || y > top + 2)
+                    return false;
+                square[slot] = (y - top) * 3 + (x - 3);
+            }
+            else {
+                square[slot] = y * kStageWidth + x;
+            }
+            found++;
+        }
+    }
+    if (found != (int)units.size())
+        return false;
+    index = 0;
+    for (int i = 0; i < found; i++)
+        index = index * squares[i] + square[i];
+    index = index * 2 + turn;
+    return true;
+}
+
+bool Tablebase::SetBoard(uint64_t index, Board& board, Turn& turn)
+{
+    for (int y = 0; y < kStageHeight; y++) {
+        for (int x = 0; x < kStageWidth; x++)
+            board.stage[y][x] = -1;
+    }
+    turn = (Turn)(index & 1);
+    index >>= 1;
+    for (int i = (int)units.size() - 1; i >= 0; i--) {
+        int square = (int)(index % squares[i]);
+        index /= squares[i];
+        Pos p = IsPalaceUnit(units[i]) ? PalacePoint(units[i], square) : Pos(square % kStageWidth, square / kStageWidth);
+        if (board.stage[p.y][p.x] >= 0)
+            return false;
+        board.stage[p.y][p.x] = units[i];
+    }
+    return true;
+}
+
+// code of index at iteration, from the results of the earlier iterations.
+// iteration 0 finds the invalid positions and the mates on the board.
+uint8_t Tablebase::Solve(uint64_t index, int iteration, const uint8_t* current)
+{
+    Board board;
+    Turn turn;
+    if (!SetBoard(index, board, turn))
+        return kCodeInvalid;
+    Turn other = (turn == TURN_CHO ? TURN_HAN : TURN_CHO);
+    if (iteration == 0 && board.IsInCheck(other))
+        return kCodeInvalid;
+
+    ActionList actions;
+    board.GetPossibleActions(turn, GEN_ALL, actions);
+    CheckInfo info;
+    board.GetCheckInfo(turn, info);
+    int moves = 0, bestLoss = INT_MAX, worstWin = -1;
+    bool allWin = true;
+    for (int i = 0; i < actions.size; i++) {
+        Action a = actions[i];
+        if (!board.IsLegalAction(a, turn, info))
+            continue;
+        moves++;
+        if (iteration == 0)
+            break;
+        int captured = board.stage[a.next.y][a.next.x];
+        Board child(board);
+        child.DoAction(a);
+        Tablebase* t = (captured >= 0 ? subtables[captured] : this);
+        uint64_t childIndex;
+        if (!t->GetIndex(child, other, childIndex)) {
+            failed = true; // a subtable of another material : Generate gives up
+            return kCodeDraw;
+        }
+        uint8_t code = (t == this ? current[childIndex] : t->data[childIndex]);
+        int d = GetDistance(code);
+        if (IsLoss(code) && d < iteration)
+            bestLoss = min(bestLoss, d);
+        else if (IsWin(code) && d < iteration)
+            worstWin = max(worstWin, d);
+        else
+            allWin = false;
+    }
+    if (moves == 0)
+        return board.IsInCheck(turn) ? kCodeLoss : kCodeDraw;
+    if (iteration == 0)
+        return kCodeDraw;
+    if (bestLoss != INT_MAX)
+        return (uint8_t)(bestLoss + 1);
+    if (allWin)
+        return (uint8_t)(kCodeLoss + worstWin + 1);
+    return kCodeDraw;
+}
+
+// the tables of the materials left after a capture must be in set.
+bool Tablebase::Generate(TablebaseSet& set, int threads)
+{
+    file.Close();
+    data = NULL;
+    failed = false;
+    int maxSubDistance = 0;
+    for (int id = 0; id < IDSize; id++) {
+        subtables[id] = NULL;
+        if (unitCount[id] == 0 || id == HG || id == CG)
+            continue;
+        string m = material;
+        m.erase(m.find(id > 6 ? kUnitLetters[id - CG] : (char)tolower(kUnitLetters[id - HG])), 1);
+        subtables[id] = set.Get(m);
+        if (subtables[id] == NULL)
+            return false;
+        maxSubDistance = max(maxSubDistance, subtables[id]->GetMaxDistance());
+    }
+
+    table.assign(size, kCodeDraw);
+    uint8_t* current = &table[0];
+    ParallelFor(size, threads, [&](uint64_t begin, uint64_t end) {
+        for (uint64_t i = begin; i < end; i++)
+            current[i] = Solve(i, 0, current);
+    });
+    data = current;
+
+    vector<uint8_t> next(table);
+    maxDistance = 0;
+    for (int n = 1; n <= kMaxDistance; n++) {
+        atomic<long long> changed(0);
+        ParallelFor(size, threads, [&](uint64_t begin, uint64_t end) {
+            long long count = 0;
+            for (uint64_t i = begin; i < end; i++) {
+                if (current[i] != kCodeDraw)
+                    continue;
+                uint8_t code = Solve(i, n, current);
+                if (code != kCodeDraw) {
+                    next[i] = code;
+                    count++;
+                }
+            }
+            changed += count;
+        });
+        if (changed > 0) {
+            memcpy(current, &next[0], size);
+            maxDistance = n;
+        }
+        // the results reached through captures come in up to maxSubDistance + 1
+        else if (n > maxSubDistance) {
+            break;
+        }
+    }
+    if (failed) {
+        table.clear();
+        data = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool Tablebase::Save(const string& path)
+{
+    if (data == NULL)
+        return false;
+    FILE* f = fopen(path.c_str(), "wb");
+    if (f == NULL)
+        return false;
+    TablebaseHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "JTB1", 4);
+    header.unitCount = (uint32_t)units.size();
+    for (int i = 0; i < (int)units.size(); i++)
+        header.units[i] = (uint8_t)units[i];
+    header.maxDistance = (uint32_t)maxDistance;
+    header.size = size;
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(data, 1, size, f) == size;
+    return fclose(f) == 0 && ok;
+}
+
+bool Tablebase::Load(const string& path)
+{
+    if (!file.Open(path))
+        return false;
+    const TablebaseHeader* header = (const TablebaseHeader*)file.GetData();
+    bool ok = file.GetSize() >= sizeof(TablebaseHeader) &&
+        memcmp(header->magic, "JTB1", 4) == 0 && header->unitCount == units.size() &&
+        header->size == size && file.GetSize() == sizeof(TablebaseHeader) + size;
+    for (int i = 0; ok && i < (int)units.size(); i++)
+        ok = header->units[i] == units[i];
+    if (!ok) {
+        file.Close();
+        return false;
+    }
+    table.clear();
+    maxDistance = (int)header->maxDistance;
+    data = file.GetData() + sizeof(TablebaseHeader);
+    return true;
+}
+
+TablebaseSet::TablebaseSet() : enabled(false)
+{
+}
+
+TablebaseSet::~TablebaseSet()
+{
+    for (auto& t : tables)
+        delete t.second;
+}
+
+void TablebaseSet::SetPath(const string& dir)
+{
+    path = dir;
+    struct stat st;
+    enabled = !dir.empty() && stat(dir.c_str(), &st) == 0;
+    for (auto& t : tables)
+        delete t.second;
+    tables.clear();
+}
+
+string TablebaseSet::GetFileName(const string& material)
+{
+    return path + "/" + material + ".jtb";
+}
+
+Tablebase* TablebaseSet::Get(const string& material)
+{
+    auto found = tables.find(material);
+    if (found != tables.end())
+        return found->second;
+    Tablebase* t = new Tablebase();
+    if (!t->SetMaterial(material) || !enabled || !t->Load(GetFileName(t->GetMaterial()))) {
+        delete t;
+        t = NULL;
+    }
+    tables[material] = t;
+    return t;
+}
+
+Tablebase* TablebaseSet::Generate(const string& material, int threads)
+{
+    Tablebase* t = new Tablebase();
+    if (!t->SetMaterial(material)) {
+        delete t;
+        return NULL;
+    }
+    string m = t->GetMaterial();
+    Tablebase* existing = Get(m);
+    if (existing) {
+        delete t;
+        return existing;
+    }
+    // the materials left after each possible capture first
+    for (size_t i = 0; i < m.size(); i++) {
+        if (toupper(m[i]) == 'K')
+            continue;
+        string sub = m.substr(0, i) + m.substr(i + 1);
+        if (Generate(sub, threads) == NULL) {
+            delete t;
+            return NULL;
+        }
+    }
+    if (!t->Generate(*this, threads)) {
+        delete t;
+        return NULL;
+    }
+    printf("%s : %llu positions, longest result %d plies\n", m.c_str(), (unsigned long long)t->GetSize(), t->GetMaxDistance());
+    if (!t->Save(GetFileName(m)))
+        printf("can not write %s\n", GetFileName(m).c_str());
+    delete tables[m];
+    tables[m] = t;
+    return t;
+}
+
+bool TablebaseSet::Probe(Board& board, Turn turn, int& value)
+{
+    if (!enabled)
+        return false;
+    int count = 0;
+    for (int y = 0; y < kStageHeight; y++) {
+        for (int x = 0; x < kStageWidth; x++) {
+            if (board.stage[y][x] >= 0 && ++count > TB_MAX_UNITS)
+                return false;
+        }
+    }
+
+    Tablebase* t = Get(Tablebase::GetMaterial(board));
+    Board mirror;
+    Board* b = &board;
+    Turn toMove = turn;
+    if (t == NULL) { // han in the place of cho : turn the board around
+        for (int y = 0; y < kStageHeight; y++) {
+            for (int x = 0; x < kStageWidth; x++) {
+                int id = board.stage[kStageHeight - 1 - y][x];
+                mirror.stage[y][x] = (id < 0 ? -1 : (id > 6 ? id - CG : id + CG));
+            }
+        }
+        t = Get(Tablebase::GetMaterial(mirror));
+        b = &mirror;
+        toMove = (turn == TURN_CHO ? TURN_HAN : TURN_CHO);
+    }
+    uint64_t index;
+    if (t == NULL || !t->GetIndex(*b, toMove, index))
+        return false;
+    uint8_t code = t->GetCode(index);
+    if (code == Tablebase::kCodeInvalid)
+        return false;
+    value = 0;
+    if (Tablebase::IsWin(code))
+        value = kWinValue - Tablebase::GetDistance(code);
+    else if (Tablebase::IsLoss(code))
+        value = -(kWinValue - Tablebase::GetDistance(code));
+    if (turn == TURN_HAN)
+        value = -value;
+    return true;
+}
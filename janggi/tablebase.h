@@ -0,0 +1,97 @@
+//
+//  tablebase.h
+//
+
+#ifndef tablebase_h
+#define tablebase_h
+
+#include <map>
+#include <vector>
+#include <cstdint>
+#include <atomic>
+#include "defines.h"
+#include "board.h"
+#include "mapped_file.h"
+
+class TablebaseSet;
+
+// Win / draw / loss and distance in plies, for the player to move, of
+// every position of one material. The material is written cho first in
+// upper case, then han in lower case, with the letters K (general),
+// R (chariot), N (horse), B (elephant), C (cannon), A (guard), P (soldier) :
+// "KRkaa" is a cho general and chariot against a han general and two guards.
+//
+// A position is indexed by the square of each unit, in the order of the
+// material, generals and guards counting only the 9 points of their palace,
+// times 2 for the player to move. The file is a TablebaseHeader followed by
+// one byte per index.
+class Tablebase {
+public:
+    Tablebase();
+    bool SetMaterial(const string& material);
+    const string& GetMaterial() { return material; };
+    uint64_t GetSize() { return size; };
+    int GetMaxDistance() { return maxDistance; };
+    bool GetIndex(Board& board, Turn turn, uint64_t& index); // false if board is not of this material
+    uint8_t GetCode(uint64_t index) { return data[index]; };
+    bool Generate(TablebaseSet& set, int threads); // false without the tables of the captures
+    bool Save(const string& path);
+    bool Load(const string& path);
+
+    static string GetMaterial(Board& board);
+    static bool IsWin(uint8_t code) { return code > kCodeDraw && code < kCodeLoss; };
+    static bool IsLoss(uint8_t code) { return code >= kCodeLoss && code != kCodeInvalid; };
+    static int GetDistance(uint8_t code) { return IsLoss(code) ? code - kCodeLoss : code; };
+
+    static const uint8_t kCodeDraw = 0;      // win in d plies : d
+    static const uint8_t kCodeLoss = 128;    // loss in d plies : kCodeLoss + d
+    static const uint8_t kCodeInvalid = 255; // two units on a square, or the player not to move in check
+    static const int kMaxDistance = 126;     // longer results are left as draws
+
+private:
+    bool SetBoard(uint64_t index, Board& board, Turn& turn);
+    uint8_t Solve(uint64_t index, int iteration, const uint8_t* current);
+
+    string material;
+    vector<int> units;     // unit ids, in the order of the index
+    vector<int> squares;   // 9 or kStageSquares, per unit
+    int firstSlot[IDSize]; // first unit of each id in units, -1 if none
+    int unitCount[IDSize];
+    uint64_t size;
+    int maxDistance;
+    Tablebase* subtables[IDSize]; // material after the capture of a unit of each id
+    vector<uint8_t> table; // generated
+    MappedFile file;       // loaded
+    const uint8_t* data;
+    atomic<bool> failed;   // a position of generation could not be solved
+};
+
+struct TablebaseHeader {
+    char magic[4];       // "JTB1"
+    uint32_t unitCount;
+    uint8_t units[8];    // unit ids, TB_MAX_UNITS of them used
+    uint32_t maxDistance;
+    uint32_t reserved;
+    uint64_t size;       // entries following the header
+};
+
+// The tablebases of a directory, opened on first use. A position with han
+// in the place of cho is looked up in the table of the mirrored material.
+class TablebaseSet {
+public:
+    TablebaseSet();
+    ~TablebaseSet();
+    void SetPath(const string& dir);
+    Tablebase* Get(const string& material); // NULL without a file
+    Tablebase* Generate(const string& material, int threads); // and the smaller tables it needs. NULL on failure
+    bool Probe(Board& board, Turn turn, int& value); // value from cho's point of view
+
+private:
+    string GetFileName(const string& material);
+
+    string path;
+    bool enabled; // the directory exists
+    map<string, Tablebase*> tables;
+};
+
+#endif /* tablebase_h */
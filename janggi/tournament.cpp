@@ -0,0 +1,176 @@
+//
+//  tournament.cpp
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "tournament.h"
+#include "janggi.h"
+
+bool EngineConfig::Parse(const string& spec)
+{
+    size_t colon = spec.find(':');
+    string kind = spec.substr(0, colon);
+    int value = (colon == string::npos ? 0 : atoi(spec.c_str() + colon + 1));
+    if (kind == "minmax")
+        type = SEARCH_MINMAX;
+    else if (kind == "alphabeta")
+        type = SEARCH_ALPHA_BETA;
+    else if (kind == "mcts")
+        type = SEARCH_MCTS;
+    else
+        return false;
+    if (value > 0) {
+        if (type == SEARCH_MCTS)
+            iterations = value;
+        else
+            depth = value;
+    }
+    name = spec;
+    return true;
+}
+
+void EngineConfig::Apply(Janggi& janggi)
+{
+    janggi.SetSearch(type, depth);
+    janggi.SetMCTSBudget(iterations, 0.0);
+    janggi.SetHashSize(TOURNAMENT_HASH_MB);
+    janggi.GetMateSolver().Resize(TOURNAMENT_HASH_MB);
+}
+
+double TournamentResult::GetScore()
+{
+    int games = GetGames();
+    return games ? (wins + 0.5 * draws) / games : 0.5;
+}
+
+static double ScoreToElo(double score)
+{
+    score = min(max(score, 1e-3), 1.0 - 1e-3);
+    return -400.0 * log10(1.0 / score - 1.0);
+}
+
+double TournamentResult::GetElo()
+{
+    return ScoreToElo(GetScore());
+}
+
+// from the variance of the result of one game
+double TournamentResult::GetEloMargin()
+{
+    int games = GetGames();
+    if (games < 2)
+        return 0.0;
+    double s = GetScore();
+    double variance = (wins * (1 - s) * (1 - s) + draws * (0.5 - s) * (0.5 - s) + losses * s * s) / games;
+    double deviation = sqrt(variance / games);
+    return (ScoreToElo(s + 1.96 * deviation) - ScoreToElo(s - 1.96 * deviation)) / 2;
+}
+
+void TournamentResult::Print(const string& first, const string& second)
+{
+    printf("%s vs %s : +%d =%d -%d, score %.1f%%, elo %+.1f +/- %.1f, %d games in %.1fs (%.2f games/s)\n",
+        first.c_str(), second.c_str(), wins, draws, losses, 100.0 * GetScore(), GetElo(), GetEloMargin(),
+        GetGames(), seconds, seconds > 0 ? GetGames() / seconds : 0.0);
+}
+
+Tournament::Tournament(const EngineConfig& a, const EngineConfig& b)
+  : openingPlies(TOURNAMENT_OPENING_PLIES), maxPlies(TOURNAMENT_MAX_PLIES)
+{
+    configs[0] = a;
+    configs[1] = b;
+}
+
+int Tournament::PlayGame(Janggi& first, Janggi& second, int game, GameRecord& record)
+{
+    first.NewGame();
+    second.NewGame();
+    // both games of a pair start from the same opening
+    mt19937 rng((unsigned)(game / 2) * 2654435761u + 1);
+    Janggi* cho = (game % 2 == 0) ? &first : &second;
+    Janggi* han = (game % 2 == 0) ? &second : &first;
+
+    Board board;
+    Turn turn = TURN_CHO;
+    record = GameRecord();
+    record.result = RESULT_DRAW;
+    for (int ply = 0; ply < maxPlies; ply++) {
+        vector<Action> legal = board.GetLegalActions(turn);
+        int result = 0; // from cho's point of view
+        if (legal.empty()) {
+            int v = board.GetNoActionValue(turn);
+            result = (v > 0) - (v < 0);
+        }
+        else {
+            Action a;
+            if (ply < openingPlies) {
+                a = legal[rng() % legal.size()];
+            }
+            else {
+                a = (turn == TURN_CHO ? cho : han)->CalculateNextAction(turn);
+                if (find(legal.begin(), legal.end(), a) == legal.end())
+                    result = (turn == TURN_CHO ? -1 : 1); // an illegal action loses
+            }
+            if (result == 0) {
+                cho->PerformAction(a);
+                han->PerformAction(a);
+                board.DoAction(a);
+                record.moves.push_back(a);
+                turn = (turn == TURN_CHO ? TURN_HAN : TURN_CHO);
+                continue;
+            }
+        }
+        record.result = (GameResult)result;
+        return (cho == &first) ? result : -result;
+    }
+    return 0;
+}
+
+TournamentResult Tournament::Run(int games, int threads, bool progress)
+{
+    TournamentResult result;
+    mutex lock;
+    atomic<int> next(0);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    auto worker = [&]() {
+        Janggi first, second; // reused from game to game
+        GameRecord record;
+        configs[0].Apply(first);
+        configs[1].Apply(second);
+        int game;
+        while ((game = next++) < games) {
+            int r = PlayGame(first, second, game, record);
+            lock_guard<mutex> guard(lock);
+            records.Write(record);
+            if (r > 0)
+                result.wins++;
+            else if (r < 0)
+                result.losses++;
+            else
+                result.draws++;
+            if (progress && result.GetGames() % 10 == 0) {
+                result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                result.Print(configs[0].name, configs[1].name);
+            }
+        }
+    };
+    vector<thread> pool;
+    for (int i = 1; i < threads; i++)
+        pool.push_back(thread(worker));
+    worker();
+    for (thread& t : pool)
+        t.join();
+
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    records.Close();
+    return result;
+}
@@ -0,0 +1,62 @@
+//
+//  tournament.h
+//
+
+#ifndef tournament_h
+#define tournament_h
+
+#include <string>
+#include "defines.h"
+#include "record.h"
+
+class Janggi;
+
+// How one side searches : "minmax:<depth>", "alphabeta:<depth>" or
+// "mcts:<iterations>".
+struct EngineConfig {
+    SearchType type;
+    int depth;
+    int iterations;
+    string name;
+
+    EngineConfig() : type(SEARCH_MCTS), depth(ALPHA_BETA_DEPTH), iterations(MCTS_ITERATION) {};
+    bool Parse(const string& spec);
+    void Apply(Janggi& janggi);
+};
+
+// Results of the first engine against the second.
+struct TournamentResult {
+    int wins;
+    int draws;
+    int losses;
+    double seconds;
+
+    TournamentResult() : wins(0), draws(0), losses(0), seconds(0.0) {};
+    int GetGames() { return wins + draws + losses; };
+    double GetScore(); // 0 to 1
+    double GetElo();
+    double GetEloMargin(); // half width of the 95% interval
+    void Print(const string& first, const string& second);
+};
+
+// Plays games between two engines on a pool of threads, without any
+// output but the summary. Games go by pairs on the same random opening,
+// each engine playing cho once.
+class Tournament {
+public:
+    Tournament(const EngineConfig& a, const EngineConfig& b);
+    void SetOpeningPlies(int plies) { openingPlies = plies; };
+    void SetMaxPlies(int plies) { maxPlies = plies; };
+    bool SetRecordPath(const string& path) { return records.Open(path, true); }; // appends every game played
+    TournamentResult Run(int games, int threads, bool progress = true);
+
+private:
+    int PlayGame(Janggi& first, Janggi& second, int game, GameRecord& record); // +1 : first won, 0 : draw, -1 : first lost
+
+    EngineConfig configs[2];
+    int openingPlies;
+    int maxPlies;
+    GameRecordWriter records;
+};
+
+#endif /* tournament_h */
@@ -0,0 +1,67 @@
+//
+//  trace.cpp
+//
+
+#include "trace.h"
+
+#if JANGGI_TRACE
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+// buffers live until the process ends, so that the events of finished
+// threads can still be exported.
+static mutex registryLock;
+static vector<TraceBuffer*> registry;
+
+uint64_t Tracer::Now()
+{
+    return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TraceBuffer* Tracer::GetThreadBuffer()
+{
+    static thread_local TraceBuffer* buffer = NULL;
+    if (buffer == NULL) {
+        lock_guard<mutex> guard(registryLock);
+        buffer = new TraceBuffer((int)registry.size() + 1);
+        registry.push_back(buffer);
+    }
+    return buffer;
+}
+
+bool Tracer::WriteChromeTrace(const string& path)
+{
+    FILE* f = fopen(path.c_str(), "w");
+    if (f == NULL)
+        return false;
+    lock_guard<mutex> guard(registryLock);
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    bool first = true;
+    for (TraceBuffer* b : registry) {
+        uint64_t end = b->count.load(memory_order_acquire);
+        uint64_t begin = end > TRACE_BUFFER_EVENTS ? end - TRACE_BUFFER_EVENTS : 0;
+        for (uint64_t i = begin; i < end; i++) {
+            const TraceEvent& e = b->events[i % TRACE_BUFFER_EVENTS];
+            fprintf(f, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                first ? "" : ",", e.name, b->tid, e.start / 1000.0, e.duration / 1000.0);
+            if (e.arg >= 0)
+                fprintf(f, ",\"args\":{\"n\":%d}", e.arg);
+            fprintf(f, "}");
+            first = false;
+        }
+    }
+    fprintf(f, "\n]}\n");
+    return fclose(f) == 0;
+}
+
+void Tracer::Clear()
+{
+    lock_guard<mutex> guard(registryLock);
+    for (TraceBuffer* b : registry)
+        b->count.store(0, memory_order_release);
+}
+
+#endif
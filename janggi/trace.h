@@ -0,0 +1,79 @@
+//
+//  trace.h
+//
+
+#ifndef trace_h
+#define trace_h
+
+#include "defines.h"
+
+// TRACE_SCOPE("name") records the time spent until the end of the
+// enclosing block, TRACE_SCOPE_ARG("name", n) also records an integer.
+// Each thread writes to its own ring buffer without locking, and
+// Tracer::WriteChromeTrace() exports every buffer in the format of
+// chrome://tracing and Perfetto. Without JANGGI_TRACE the macros are empty.
+#if JANGGI_TRACE
+
+#include <cstdint>
+#include <atomic>
+#include <string>
+
+struct TraceEvent {
+    const char* name; // a literal, never freed
+    uint64_t start;   // ns
+    uint64_t duration;
+    int arg;
+};
+
+// Written by one thread only. A reader sees the events published by the
+// count, and should read while the writer is idle if the ring has wrapped.
+class TraceBuffer {
+public:
+    TraceBuffer(int tid) : count(0), tid(tid) {};
+    void Push(const char* name, uint64_t start, uint64_t duration, int arg) {
+        uint64_t n = count.load(memory_order_relaxed);
+        TraceEvent& e = events[n % TRACE_BUFFER_EVENTS];
+        e.name = name;
+        e.start = start;
+        e.duration = duration;
+        e.arg = arg;
+        count.store(n + 1, memory_order_release);
+    };
+
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+    atomic<uint64_t> count;
+    int tid;
+};
+
+class Tracer {
+public:
+    static uint64_t Now(); // ns, steady clock
+    static TraceBuffer* GetThreadBuffer();
+    static bool WriteChromeTrace(const string& path);
+    static void Clear(); // while no thread is tracing
+};
+
+class TraceScope {
+public:
+    TraceScope(const char* name, int arg = -1) : name(name), arg(arg), start(Tracer::Now()) {};
+    ~TraceScope() { Tracer::GetThreadBuffer()->Push(name, start, Tracer::Now() - start, arg); };
+
+private:
+    const char* name;
+    int arg;
+    uint64_t start;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_SCOPE_ARG(name, arg) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name, arg)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_SCOPE_ARG(name, arg)
+
+#endif
+
+#endif /* trace_h */
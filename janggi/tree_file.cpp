@@ -0,0 +1,171 @@
+//
+//  tree_file.cpp
+//
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include "tree_file.h"
+#include "mapped_file.h"
+
+static void PackNode(Node& n, uint32_t firstChild, PackedNode& p)
+{
+    Node* target = n.Target();
+    memset(&p, 0, sizeof(p));
+    p.totalScore = target->totalScore;
+    p.visitCount = target->visitCount;
+    p.staticValue = n.staticValue;
+    p.prior = (float)n.prior;
+    p.move = n.GetAction().Pack();
+    p.flags = n.hasStaticValue ? kTreeStaticValue : 0;
+    if (n.link == NULL && !n.isLeaf) {
+        p.flags |= kTreeExpanded;
+        p.firstChild = firstChild;
+        p.childCount = (uint16_t)n.children.size();
+    }
+}
+
+bool WriteTree(const string& path, Node& root, Turn turn)
+{
+    // breadth first : the children of order[i] are given indexes as it is
+    // reached, after every node already listed.
+    vector<Node*> order(1, &root);
+    for (size_t i = 0; i < order.size(); i++) {
+        Node* n = order[i];
+        if (n->link == NULL && !n->isLeaf) {
+            for (Node& child : n->children)
+                order.push_back(&child);
+        }
+    }
+    if (order.size() > UINT32_MAX)
+        return false;
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == NULL)
+        return false;
+    TreeFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "JMT1", 4);
+    header.nodeCount = (uint32_t)order.size();
+    header.hash = root.board.GetHash(turn);
+    for (int y = 0; y < kStageHeight; y++) {
+        for (int x = 0; x < kStageWidth; x++)
+            header.root.squares[y * kStageWidth + x] = (uint8_t)(root.board.stage[y][x] + 1);
+    }
+    header.root.turn = (uint8_t)turn;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    uint32_t next = 1; // index of the next children
+    PackedNode buffer[256];
+    size_t buffered = 0;
+    for (size_t i = 0; ok && i < order.size(); i++) {
+        PackNode(*order[i], next, buffer[buffered]);
+        next += buffer[buffered].childCount;
+        if (++buffered == 256 || i + 1 == order.size()) {
+            ok = fwrite(buffer, sizeof(PackedNode), buffered, file) == buffered;
+            buffered = 0;
+        }
+    }
+    ok = fclose(file) == 0 && ok;
+    return ok;
+}
+
+// a move read from a file : on the stage, and one the player can make.
+static bool IsSound(Board& board, Action a, Turn turn)
+{
+    return a.IsOnStage() && board.IsPossibleAction(a, turn);
+}
+
+// statistics read from a file : UCT and PUCT need them finite, and the
+// visits positive.
+static bool IsSound(const PackedNode& p)
+{
+    return p.visitCount >= 0 && std::isfinite(p.totalScore) && std::isfinite(p.prior);
+}
+
+bool ReadTree(const string& path, Node& root, Turn& turn, NodePool& pool)
+{
+    MappedFile file;
+    if (!file.Open(path) || file.GetSize() < sizeof(TreeFileHeader))
+        return false;
+    const TreeFileHeader* header = (const TreeFileHeader*)file.GetData();
+    const PackedNode* nodes = (const PackedNode*)(file.GetData() + sizeof(TreeFileHeader));
+    size_t count = header->nodeCount;
+    if (memcmp(header->magic, "JMT1", 4) != 0 || count == 0 ||
+        file.GetSize() != sizeof(TreeFileHeader) + count * sizeof(PackedNode))
+        return false;
+    // every child after its parent, so that the tree has no cycle
+    for (size_t i = 0; i < count; i++) {
+        if ((nodes[i].flags & kTreeExpanded) &&
+            (nodes[i].firstChild <= i || nodes[i].firstChild + (size_t)nodes[i].childCount > count))
+            return false;
+        if (!IsSound(nodes[i]))
+            return false;
+    }
+    for (int i = 0; i < kStageSquares; i++) {
+        if (header->root.squares[i] > IDSize)
+            return false;
+    }
+    if (header->root.turn != TURN_CHO && header->root.turn != TURN_HAN)
+        return false;
+
+    Board board;
+    for (int y = 0; y < kStageHeight; y++) {
+        for (int x = 0; x < kStageWidth; x++)
+            board.stage[y][x] = (int)header->root.squares[y * kStageWidth + x] - 1;
+    }
+    Turn rootTurn = (Turn)header->root.turn;
+    if (board.GetHash(rootTurn) != header->hash)
+        return false;
+
+    Node loaded(board);
+    loaded.hash = header->hash;
+
+    // the nodes by index as they are built, with the player to move there.
+    // children arrays are filled to their reserved size at once, so the
+    // pointers stay valid.
+    vector<pair<Node*, Turn> > built(count, make_pair((Node*)NULL, rootTurn));
+    built[0].first = &loaded;
+    bool sound = true;
+    for (size_t i = 0; sound && i < count; i++) {
+        Node* n = built[i].first;
+        const PackedNode& p = nodes[i];
+        if (n == NULL) // not the child of any node
+            continue;
+        n->totalScore = p.totalScore;
+        n->visitCount = p.visitCount;
+        n->prior = p.prior;
+        n->staticValue = p.staticValue;
+        n->hasStaticValue = (p.flags & kTreeStaticValue) != 0;
+        if (!(p.flags & kTreeExpanded))
+            continue;
+        Turn next = (built[i].second == TURN_CHO ? TURN_HAN : TURN_CHO);
+        pool.Acquire(p.childCount, n->children, true);
+        n->isLeaf = false;
+        for (int c = 0; sound && c < p.childCount; c++) {
+            Action a = Action::Unpack(nodes[p.firstChild + c].move);
+            sound = IsSound(n->board, a, built[i].second);
+            if (!sound)
+                break;
+            Node child(n->board);
+            child.hash = n->board.UpdateHash(n->hash, a);
+            child.DoAction(a);
+            n->children.push_back(child);
+            built[p.firstChild + c] = make_pair(&n->children.back(), next);
+        }
+    }
+    if (!sound) {
+        pool.Release(loaded.children);
+        return false;
+    }
+
+    // the arrays move over as they are, a copy of a node would copy them
+    vector<Node> children;
+    children.swap(loaded.children);
+    pool.Release(root.children);
+    root = loaded; // no children left to copy
+    root.children.swap(children);
+    turn = rootTurn;
+    return true;
+}
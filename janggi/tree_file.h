@@ -0,0 +1,48 @@
+//
+//  tree_file.h
+//
+
+#ifndef tree_file_h
+#define tree_file_h
+
+#include <cstdint>
+#include <string>
+#include "defines.h"
+#include "node.h"
+#include "record.h"
+
+// MCTS tree files : a TreeFileHeader, then the nodes breadth first, the
+// root first. The children of a node are consecutive, after their parent,
+// so that a file read in order gives every node its parent first. Boards
+// and hashes are not stored : they follow from the root and the moves.
+struct TreeFileHeader {
+    char magic[4];         // "JMT1"
+    uint32_t nodeCount;
+    uint64_t hash;         // of the root, with the player to move
+    RecordPosition root;   // board and player to move
+    uint32_t reserved;
+};
+
+struct PackedNode {
+    double totalScore;
+    int32_t visitCount;
+    int32_t staticValue;   // valid with kTreeStaticValue
+    uint32_t firstChild;   // index of the first child
+    float prior;
+    uint16_t childCount;
+    uint16_t move;         // Action::Pack(), of the root : kNullPackedAction
+    uint8_t flags;
+    uint8_t reserved[3];
+};
+
+const uint8_t kTreeExpanded = 1;    // the children are known, there may be none
+const uint8_t kTreeStaticValue = 2;
+
+// The tree under root. A node linked to a transposition is written with the
+// statistics it shares, as a leaf : the subtree it views is not its own.
+bool WriteTree(const string& path, Node& root, Turn turn);
+// Rebuilds the tree of a file read through a mapping, the children arrays
+// taken from pool. root is unchanged when the file is not a tree.
+bool ReadTree(const string& path, Node& root, Turn& turn, NodePool& pool);
+
+#endif /* tree_file_h */
@@ -0,0 +1,233 @@
+//
+//  tt.cpp
+//
+
+#include <cstring>
+#include <thread>
+#include <chrono>
+#include "tt.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const uint32_t kSharedMagic = 0x3154544a; // "JTT1"
+
+// the start of a shared segment, the slots follow. ready is set by the
+// process which created the segment once count is written.
+struct TTSharedHeader {
+    atomic<uint32_t> ready;
+    uint32_t reserved;
+    uint64_t count;
+    uint8_t padding[48]; // the slots start on a cache line
+};
+
+// the number of entries is the largest power of two that fits in mb.
+static size_t EntryCount(size_t mb)
+{
+    size_t count = 1;
+    size_t bytes = (mb > 0 ? mb : 1) << 20;
+    while (count * 2 * sizeof(TTSlot) <= bytes)
+        count *= 2;
+    return count;
+}
+
+static uint64_t PackEntry(int score, int depth, Bound bound, unsigned short move)
+{
+    return (uint64_t)(uint32_t)score | (uint64_t)move << 32 |
+        (uint64_t)(uint8_t)depth << 48 | (uint64_t)(uint8_t)bound << 56;
+}
+
+static void UnpackEntry(uint64_t data, TTEntry& entry)
+{
+    entry.score = (int32_t)(uint32_t)data;
+    entry.move = (unsigned short)(data >> 32);
+    entry.depth = (int8_t)(data >> 48);
+    entry.bound = (uint8_t)(data >> 56);
+}
+
+TranspositionTable::TranspositionTable(size_t mb) : slots(NULL), mask(0), shared(NULL), sharedSize(0)
+#ifdef _WIN32
+  , mapping(NULL)
+#endif
+{
+    Resize(mb);
+}
+
+void TranspositionTable::Resize(size_t mb)
+{
+    CloseShared();
+    size_t count = EntryCount(mb);
+    entries.reset(new TTSlot[count]);
+    slots = entries.get();
+    mask = count - 1;
+    Clear();
+}
+
+void TranspositionTable::Clear()
+{
+    if (shared)
+        return;
+    for (size_t i = 0; i <= mask; i++) {
+        slots[i].check.store(0, memory_order_relaxed);
+        slots[i].data.store(0, memory_order_relaxed);
+    }
+}
+
+// a slot of zeros is empty : its bound is BOUND_NONE.
+bool TranspositionTable::Probe(uint64_t hash, TTEntry& entry)
+{
+    const TTSlot& slot = slots[hash & mask];
+    uint64_t data = slot.data.load(memory_order_relaxed);
+    uint64_t check = slot.check.load(memory_order_relaxed);
+    if ((check ^ data) != hash)
+        return false;
+    UnpackEntry(data, entry);
+    if (entry.bound == BOUND_NONE)
+        return false;
+    entry.key = hash;
+    return true;
+}
+
+void TranspositionTable::Store(uint64_t hash, int score, int depth, Bound bound, Action move)
+{
+    TTSlot& slot = slots[hash & mask];
+    TTEntry e;
+    bool same = Probe(hash, e);
+    if (same && depth < e.depth)
+        return;
+    // a fail-low result knows no best action, keep the one found earlier
+    unsigned short packed = move.Pack();
+    if (packed == kNullPackedAction && same)
+        packed = e.move;
+    uint64_t data = PackEntry(score, depth, bound, packed);
+    slot.data.store(data, memory_order_relaxed);
+    slot.check.store(hash ^ data, memory_order_relaxed);
+}
+
+#ifdef _WIN32
+
+bool TranspositionTable::OpenShared(const string& name, size_t mb)
+{
+    size_t count = EntryCount(mb);
+    unsigned long long bytes = sizeof(TTSharedHeader) + count * sizeof(TTSlot);
+    HANDLE m = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                  (DWORD)(bytes >> 32), (DWORD)bytes, name.c_str());
+    if (m == NULL)
+        return false;
+    bool created = GetLastError() != ERROR_ALREADY_EXISTS;
+    void* view = MapViewOfFile(m, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (view == NULL) {
+        CloseHandle(m);
+        return false;
+    }
+    TTSharedHeader* header = (TTSharedHeader*)view;
+    if (created) {
+        header->count = count;
+        header->ready.store(kSharedMagic, memory_order_release);
+    }
+    for (int i = 0; i < 1000 && header->ready.load(memory_order_acquire) != kSharedMagic; i++)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    MEMORY_BASIC_INFORMATION info;
+    if (header->ready.load(memory_order_acquire) != kSharedMagic ||
+        VirtualQuery(view, &info, sizeof(info)) == 0 ||
+        info.RegionSize < sizeof(TTSharedHeader) + header->count * sizeof(TTSlot)) {
+        UnmapViewOfFile(view);
+        CloseHandle(m);
+        return false;
+    }
+    CloseShared();
+    entries.reset();
+    mapping = m;
+    shared = view;
+    sharedSize = (size_t)info.RegionSize;
+    slots = (TTSlot*)(header + 1);
+    mask = header->count - 1;
+    return true;
+}
+
+void TranspositionTable::CloseShared()
+{
+    if (shared)
+        UnmapViewOfFile(shared);
+    if (mapping)
+        CloseHandle(mapping);
+    shared = mapping = NULL;
+    sharedSize = 0;
+}
+
+#else
+
+// the segment stays, with its results, after the last engine closes it,
+// until it is removed from /dev/shm.
+bool TranspositionTable::OpenShared(const string& name, size_t mb)
+{
+    string path = (name.empty() || name[0] != '/') ? "/" + name : name;
+    size_t count = EntryCount(mb);
+    size_t bytes = sizeof(TTSharedHeader) + count * sizeof(TTSlot);
+    bool created = true;
+    int fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600); // only its user may write it
+    if (fd < 0) {
+        created = false;
+        fd = shm_open(path.c_str(), O_RDWR, 0);
+    }
+    if (fd < 0)
+        return false;
+    if (created && ftruncate(fd, (off_t)bytes) != 0) {
+        close(fd);
+        shm_unlink(path.c_str());
+        return false;
+    }
+    // the creator may not have sized the segment yet. a segment of another
+    // user is not trusted.
+    struct stat st;
+    for (int i = 0; ; i++) {
+        if (fstat(fd, &st) != 0 || st.st_uid != geteuid() || i == 1000) {
+            close(fd);
+            return false;
+        }
+        if ((size_t)st.st_size >= sizeof(TTSharedHeader))
+            break;
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    bytes = (size_t)st.st_size;
+    void* view = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the segment
+    if (view == MAP_FAILED)
+        return false;
+    TTSharedHeader* header = (TTSharedHeader*)view;
+    if (created) {
+        header->count = count;
+        header->ready.store(kSharedMagic, memory_order_release);
+    }
+    for (int i = 0; i < 1000 && header->ready.load(memory_order_acquire) != kSharedMagic; i++)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    uint64_t n = header->count;
+    if (header->ready.load(memory_order_acquire) != kSharedMagic ||
+        n == 0 || (n & (n - 1)) != 0 || bytes < sizeof(TTSharedHeader) + n * sizeof(TTSlot)) {
+        munmap(view, bytes);
+        return false;
+    }
+    CloseShared();
+    entries.reset();
+    shared = view;
+    sharedSize = bytes;
+    slots = (TTSlot*)(header + 1);
+    mask = (size_t)n - 1;
+    return true;
+}
+
+void TranspositionTable::CloseShared()
+{
+    if (shared)
+        munmap(shared, sharedSize);
+    shared = NULL;
+    sharedSize = 0;
+}
+
+#endif
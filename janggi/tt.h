@@ -0,0 +1,69 @@
+//
+//  tt.h
+//
+
+#ifndef tt_h
+#define tt_h
+
+#include <memory>
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include "defines.h"
+#include "action.h"
+
+enum Bound {
+    BOUND_NONE,
+    BOUND_UPPER, // the value is at most score
+    BOUND_LOWER, // the value is at least score
+    BOUND_EXACT,
+};
+
+// score is from cho's point of view, as everywhere in the search.
+struct TTEntry {
+    uint64_t key;
+    int32_t score;
+    unsigned short move; // Action::Pack()
+    int8_t depth;
+    uint8_t bound;
+};
+
+// A slot holds an entry packed in data, and the key xor data. Both words
+// are written without a lock, so a slot half written by another thread or
+// process does not check against any key and reads as empty.
+struct TTSlot {
+    atomic<uint64_t> check;
+    atomic<uint64_t> data;
+};
+
+// Hash table of alpha-beta results, indexed by Board::GetHash. One entry
+// per slot, a deeper result is kept over a shallower one of the same
+// position. The table is private to the engine, or a named shared memory
+// segment which every engine process opening the same name uses at once.
+class TranspositionTable {
+public:
+    TranspositionTable(size_t mb = TT_SIZE_MB);
+    ~TranspositionTable() { CloseShared(); };
+    void Resize(size_t mb); // a private table again
+    bool OpenShared(const string& name, size_t mb); // mb when created, else the size of the segment
+    bool IsShared() { return shared != NULL; };
+    void Clear(); // the results of others are kept in a shared table
+    bool Probe(uint64_t hash, TTEntry& entry);
+    void Store(uint64_t hash, int score, int depth, Bound bound, Action move);
+
+private:
+    TranspositionTable(const TranspositionTable&);            // not copyable
+    TranspositionTable& operator=(const TranspositionTable&);
+    void CloseShared();
+
+    unique_ptr<TTSlot[]> entries;
+    TTSlot* slots;   // entries, or those of the shared segment
+    size_t mask;
+    void* shared;    // the mapped segment, NULL : private
+    size_t sharedSize;
+#ifdef _WIN32
+    void* mapping;
+#endif
+};
+
+#endif /* tt_h */
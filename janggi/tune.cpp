@@ -0,0 +1,227 @@
+//
+//  tune.cpp
+//
+
+#include <cmath>
+#include <thread>
+#include "tune.h"
+#include "record.h"
+
+static const int kKinds = IDSize / 2;
+static const int kCodes = IDSize + 1;
+static const int kSquareWeights = kKinds; // index of the first piece-square weight
+
+static int SquareWeight(int kind, int y, int x)
+{
+    return kSquareWeights + (kind * kStageHeight + y) * kStageWidth + x;
+}
+
+// the weights of unit code on square : its material and its piece-square
+// value, read upside down for han. -1 : no weight.
+static void GetWeights(int square, int code, int& material, int& pieceSquare, int& sign)
+{
+    int unit = code - 1;
+    int y = square / kStageWidth, x = square % kStageWidth;
+    material = pieceSquare = -1;
+    sign = 0;
+    if (code == 0 || unit == HG || unit == CG)
+        return;
+    if (unit >= CG) {
+        material = unit - CG;
+        pieceSquare = SquareWeight(unit - CG, y, x);
+        sign = 1;
+    }
+    else {
+        material = unit;
+        pieceSquare = SquareWeight(unit, kStageHeight - 1 - y, x);
+        sign = -1;
+    }
+}
+
+Tuner::Tuner(int threads) :
+    threads(threads > 0 ? threads : 1), weights(kSquareWeights + kKinds * kStageSquares, 0.0),
+    table(kStageSquares * kCodes, 0.0), scale(1.0)
+{
+    const EvalParams& params = GetEvalParams();
+    for (int k = 1; k < kKinds; k++) {
+        weights[k] = params.material[k];
+        for (int y = 0; y < kStageHeight; y++)
+            for (int x = 0; x < kStageWidth; x++)
+                weights[SquareWeight(k, y, x)] = params.pieceSquare[k][y][x];
+    }
+    BuildTable();
+}
+
+// The positions of every game with a result, from skipPlies on, up to its
+// first impossible move. A position whose next move captures is not quiet,
+// its value is about to change.
+long long Tuner::AddRecords(const string& path, int skipPlies)
+{
+    GameRecordReader reader;
+    if (!reader.Open(path))
+        return -1;
+    long long added = 0;
+    GameView view;
+    Board board;
+    Turn turn;
+    while (reader.Next(view)) {
+        GameResult result = view.GetResult();
+        if (result == RESULT_UNKNOWN)
+            continue;
+        view.GetStart(board, turn);
+        for (int i = 0; i < view.GetMoveCount(); i++) {
+            Action a = view.GetMove(i);
+            if (!a.IsOnStage() || !board.IsPossibleAction(a, turn))
+                break; // the rest of the game is not known
+            if (i >= skipPlies && board.stage[a.next.y][a.next.x] == -1) {
+                TunePosition p;
+                for (int y = 0; y < kStageHeight; y++)
+                    for (int x = 0; x < kStageWidth; x++)
+                        p.squares[y * kStageWidth + x] = (uint8_t)(board.stage[y][x] + 1);
+                p.result = (int8_t)result;
+                positions.push_back(p);
+                added++;
+            }
+            board.DoAction(a);
+            turn = (turn == TURN_CHO ? TURN_HAN : TURN_CHO);
+        }
+    }
+    return added;
+}
+
+void Tuner::BuildTable()
+{
+    for (int sq = 0; sq < kStageSquares; sq++) {
+        for (int code = 0; code < kCodes; code++) {
+            int material, pieceSquare, sign;
+            GetWeights(sq, code, material, pieceSquare, sign);
+            table[sq * kCodes + code] = sign == 0 ? 0.0 : sign * (weights[material] + weights[pieceSquare]);
+        }
+    }
+}
+
+void Tuner::EvaluateRange(size_t begin, size_t end, double* error, double* gradient)
+{
+    const double* values = &table[0];
+    double sum = 0.0;
+    for (size_t i = begin; i < end; i++) {
+        const uint8_t* squares = positions[i].squares;
+        double value = 0.0;
+        for (int sq = 0; sq < kStageSquares; sq++)
+            value += values[sq * kCodes + squares[sq]];
+        double predicted = 1.0 / (1.0 + exp(-scale * value));
+        double target = (positions[i].result + 1) * 0.5;
+        double diff = predicted - target;
+        sum += diff * diff;
+        if (gradient == NULL)
+            continue;
+        // d(diff^2)/d(value), the sign of each unit applied below
+        double d = 2.0 * diff * scale * predicted * (1.0 - predicted);
+        for (int sq = 0; sq < kStageSquares; sq++) {
+            if (squares[sq] == 0)
+                continue;
+            int material, pieceSquare, sign;
+            GetWeights(sq, squares[sq], material, pieceSquare, sign);
+            if (sign == 0)
+                continue;
+            gradient[material] += sign * d;
+            gradient[pieceSquare] += sign * d;
+        }
+    }
+    *error = sum;
+}
+
+double Tuner::Evaluate(vector<double>* gradient)
+{
+    if (positions.empty())
+        return 0.0;
+    size_t n = positions.size();
+    vector<double> errors(threads, 0.0);
+    vector<vector<double> > gradients(gradient ? threads : 0, vector<double>(weights.size(), 0.0));
+    vector<thread> pool;
+    for (int t = 0; t < threads; t++) {
+        size_t begin = n * t / threads, end = n * (t + 1) / threads;
+        pool.push_back(thread(&Tuner::EvaluateRange, this, begin, end, &errors[t],
+                              gradient ? &gradients[t][0] : (double*)NULL));
+    }
+    for (thread& t : pool)
+        t.join();
+    double error = 0.0;
+    for (int t = 0; t < threads; t++)
+        error += errors[t];
+    error /= n;
+    if (gradient) {
+        gradient->assign(weights.size(), 0.0);
+        for (int t = 0; t < threads; t++)
+            for (size_t w = 0; w < weights.size(); w++)
+                (*gradient)[w] += gradients[t][w] / n;
+    }
+    // piece-square values seen in a few positions stay near 0
+    for (size_t w = kSquareWeights; w < weights.size(); w++) {
+        error += TUNE_L2 * weights[w] * weights[w];
+        if (gradient)
+            (*gradient)[w] += 2.0 * TUNE_L2 * weights[w];
+    }
+    return error;
+}
+
+// golden section search of the error over the scale.
+double Tuner::FitScale()
+{
+    const double ratio = (sqrt(5.0) - 1.0) / 2.0;
+    double low = 0.001, high = 2.0;
+    for (int i = 0; i < 40; i++) {
+        double a = high - ratio * (high - low), b = low + ratio * (high - low);
+        scale = a;
+        double errorA = Evaluate(NULL);
+        scale = b;
+        double errorB = Evaluate(NULL);
+        if (errorA < errorB)
+            high = b;
+        else
+            low = a;
+    }
+    scale = (low + high) / 2.0;
+    return scale;
+}
+
+// Adam steps over the whole set, the gradients of a square and its
+// mirror summed so that both stay equal.
+double Tuner::Run(int epochs, double rate, ostream& log)
+{
+    const double beta1 = 0.9, beta2 = 0.999;
+    vector<double> gradient, m(weights.size(), 0.0), v(weights.size(), 0.0);
+    double error = 0.0;
+    for (int epoch = 1; epoch <= epochs; epoch++) {
+        error = Evaluate(&gradient);
+        for (int k = 1; k < kKinds; k++) {
+            for (int y = 0; y < kStageHeight; y++) {
+                for (int x = 0; x < kStageWidth / 2; x++) {
+                    int left = SquareWeight(k, y, x), right = SquareWeight(k, y, kStageWidth - 1 - x);
+                    gradient[left] = gradient[right] = (gradient[left] + gradient[right]) / 2.0;
+                }
+            }
+        }
+        for (size_t w = 0; w < weights.size(); w++) {
+            m[w] = beta1 * m[w] + (1.0 - beta1) * gradient[w];
+            v[w] = beta2 * v[w] + (1.0 - beta2) * gradient[w] * gradient[w];
+            double mHat = m[w] / (1.0 - pow(beta1, epoch));
+            double vHat = v[w] / (1.0 - pow(beta2, epoch));
+            weights[w] -= rate * mHat / (sqrt(vHat) + 1e-8);
+        }
+        BuildTable();
+        if (epoch % 50 == 0 || epoch == epochs)
+            log << "epoch " << epoch << " error " << error << endl;
+    }
+    return Evaluate(NULL);
+}
+
+void Tuner::GetParams(EvalParams& params)
+{
+    for (int k = 0; k < kKinds; k++) {
+        params.material[k] = (k == HG ? 0 : (int)lround(weights[k]));
+        for (int y = 0; y < kStageHeight; y++)
+            for (int x = 0; x < kStageWidth; x++)
+                params.pieceSquare[k][y][x] = (k == HG ? 0 : (int)lround(weights[SquareWeight(k, y, x)]));
+    }
+}
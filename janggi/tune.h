@@ -0,0 +1,50 @@
+//
+//  tune.h
+//
+
+#ifndef tune_h
+#define tune_h
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "defines.h"
+#include "eval.h"
+
+// A position of a finished game, labeled with the result.
+struct TunePosition {
+    uint8_t squares[kStageSquares]; // unit id + 1, 0 : empty
+    int8_t result;                  // GameResult, from cho's point of view
+};
+
+// Texel tuning of the weights of eval.h : the result of a game is
+// predicted from the evaluation of its quiet positions by
+// 1 / (1 + exp(-scale * value)), and the weights minimize the mean squared
+// error of the prediction, plus an L2 penalty on piece-square values, by
+// gradient descent. Error and gradient are summed by a pool of threads,
+// each over its own share of the positions. Piece-square values are kept
+// symmetric left to right.
+class Tuner {
+public:
+    Tuner(int threads);
+    long long AddRecords(const string& path, int skipPlies = TUNE_SKIP_PLIES); // positions added, -1 : no records
+    long long GetSize() { return (long long)positions.size(); };
+    double FitScale();   // the scale which fits the current weights best
+    double Run(int epochs, double rate, ostream& log); // returns the error reached
+    double GetError() { return Evaluate(NULL); };
+    void GetParams(EvalParams& params); // rounded to whole points
+
+private:
+    double Evaluate(vector<double>* gradient); // mean squared error, and its gradient
+    void EvaluateRange(size_t begin, size_t end, double* error, double* gradient);
+    void BuildTable();
+
+    int threads;
+    vector<TunePosition> positions;
+    vector<double> weights; // material of each kind, then piece-square values of each kind
+    vector<double> table;   // value of unit code on square, as the table of eval.cpp
+    double scale;
+};
+
+#endif /* tune_h */
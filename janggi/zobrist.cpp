@@ -0,0 +1,43 @@
+//
+//  zobrist.cpp
+//
+
+#include "zobrist.h"
+
+static uint64_t SplitMix64(uint64_t& state)
+{
+  uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+struct ZobristKeys {
+  uint64_t unit[IDSize][kStageHeight][kStageWidth];
+  uint64_t turn;
+
+  ZobristKeys() {
+    uint64_t state = 0x4A414E474749ULL; // "JANGGI"
+    for (int id = 0; id < IDSize; id++)
+      for (int y = 0; y < kStageHeight; y++)
+        for (int x = 0; x < kStageWidth; x++)
+          unit[id][y][x] = SplitMix64(state);
+    turn = SplitMix64(state);
+  }
+};
+
+static const ZobristKeys& Keys()
+{
+  static const ZobristKeys keys;
+  return keys;
+}
+
+uint64_t ZobristUnitKey(int unitID, int x, int y)
+{
+  return Keys().unit[unitID][y][x];
+}
+
+uint64_t ZobristTurnKey()
+{
+  return Keys().turn;
+}
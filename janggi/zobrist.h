@@ -0,0 +1,16 @@
+//
+//  zobrist.h
+//
+
+#ifndef zobrist_h
+#define zobrist_h
+
+#include <cstdint>
+#include "defines.h"
+
+// The keys are generated from a fixed seed, so that a hash means the same
+// position in every process.
+uint64_t ZobristUnitKey(int unitID, int x, int y);
+uint64_t ZobristTurnKey(); // xor'ed in when han is to move
+
+#endif /* zobrist_h */